@@ -52,13 +52,36 @@ class omnistat_annotate:
         with open(self.filename, "w") as outfile:
             outfile.write(json.dumps(data, indent=4))
             outfile.write("\n")
+
+        self.__write_marker("start " + label.replace("\n", " "))
         return
 
     def stop(self):
         if os.path.exists(self.filename):
             os.remove(self.filename)
+
+        self.__write_marker("stop")
         return
 
+    def __write_marker(self, marker):
+        """Mirror the annotation into the kernel tracing library's marker
+        fifo (OMNISTAT_TRACE_ANNOTATIONS) so tracers roll up per-kernel
+        aggregates per annotation window. A no-op when the variable is unset
+        or no tracer holds the fifo open."""
+        fifo = os.environ.get("OMNISTAT_TRACE_ANNOTATIONS")
+        if not fifo:
+            return
+        try:
+            fd = os.open(fifo, os.O_WRONLY | os.O_NONBLOCK)
+        except OSError:
+            return
+        try:
+            os.write(fd, (marker + "\n").encode())
+        except OSError:
+            pass
+        finally:
+            os.close(fd)
+
 
 def main():
     parser = argparse.ArgumentParser()
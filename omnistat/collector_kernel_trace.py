@@ -24,15 +24,112 @@
 
 import configparser
 import logging
+import struct
 import threading
 import time
-from collections import OrderedDict, defaultdict
+from collections import OrderedDict, defaultdict, deque
 
 import orjson
 from flask import Flask, request
 
 from omnistat.collector_endpoint_base import EndpointCollector
 
+# Optional: tracers built with zstd can compress flush payloads
+# (OMNISTAT_TRACE_COMPRESS=1), flagged with a Content-Encoding header
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+# Binary trace payload format, shared with the rocprofiler-sdk kernel tracing
+# library (see rocprofiler-sdk/trace_format.hpp). Payloads are little-endian:
+# a 16-byte header (magic, version, flags, record count) followed by
+# length-prefixed records with fixed-width gpu_id/name_length/start/end fields.
+BINARY_CONTENT_TYPE = "application/x-omnistat-trace"
+BINARY_MAGIC = b"OMTR"
+BINARY_VERSION = 1
+BINARY_FLAG_KERNEL_IDS = 0x1
+BINARY_HEADER = struct.Struct("<4sBBHII")
+BINARY_RECORD = struct.Struct("<IIQQ")
+BINARY_ID_RECORD = struct.Struct("<IIQQQ")
+
+
+def request_payload():
+    """Return the body of the current request, decompressing zstd-encoded
+    payloads. Decompressor objects are not thread-safe, so one is created per
+    request; creation is cheap relative to the request itself."""
+    data = request.data
+    if request.content_encoding == "zstd":
+        if zstandard is None:
+            raise ValueError("zstd-encoded payload but the zstandard package is not installed")
+        data = zstandard.ZstdDecompressor().decompress(data)
+    return data
+
+
+# Counter fields every tracer health payload must carry; each scrape exports
+# exactly this set (plus latency quantiles) per live client
+HEALTH_FIELDS = (
+    "records",
+    "flushes",
+    "failed_records",
+    "failed_flushes",
+    "payload_bytes",
+    "serialize_ns",
+    "post_ns",
+    "post_attempts",
+    "queue_depth",
+    "queue_overflow_records",
+    "buffer_dropped_records",
+    "sampled_out_records",
+)
+
+
+def latency_percentile(buckets, quantile):
+    """Upper-bound estimate of a latency quantile, in nanoseconds, from the
+    tracer's log-scale histogram (bucket b counts POST attempts that took
+    [2^(b-1), 2^b) microseconds)"""
+    total = sum(buckets)
+    if total == 0:
+        return 0
+    rank = quantile * total
+    cumulative = 0
+    for b, count in enumerate(buckets):
+        cumulative += count
+        if cumulative >= rank:
+            return (1 << b) * 1_000
+    return (1 << len(buckets)) * 1_000
+
+
+def parse_binary_trace(data):
+    """Parse a binary trace payload into (client, records) where records are
+    (gpu_id, kernel, start_ns, end_ns) tuples matching the structure of the
+    JSON record format. The kernel field is the embedded name, or an integer
+    dictionary ID when the kernel-IDs header flag is set."""
+    magic, version, flags, _, num_records, client = BINARY_HEADER.unpack_from(data, 0)
+    if magic != BINARY_MAGIC:
+        raise ValueError(f"unexpected binary trace magic: {magic}")
+    if version != BINARY_VERSION:
+        raise ValueError(f"unsupported binary trace version: {version}")
+
+    records = []
+    offset = BINARY_HEADER.size
+    if flags & BINARY_FLAG_KERNEL_IDS:
+        for _ in range(num_records):
+            gpu_id, _, kernel_id, start_ns, end_ns = BINARY_ID_RECORD.unpack_from(data, offset)
+            offset += BINARY_ID_RECORD.size
+            records.append((gpu_id, kernel_id, start_ns, end_ns))
+    else:
+        for _ in range(num_records):
+            gpu_id, name_length, start_ns, end_ns = BINARY_RECORD.unpack_from(data, offset)
+            offset += BINARY_RECORD.size
+            name = data[offset : offset + name_length]
+            if len(name) != name_length:
+                raise ValueError("truncated binary trace record")
+            offset += name_length
+            records.append((gpu_id, name.decode(), start_ns, end_ns))
+
+    return client, records
+
 
 class KernelTrace(EndpointCollector):
     def __init__(self, config: configparser.ConfigParser, route: Flask.route, interval: float):
@@ -46,6 +143,11 @@ class KernelTrace(EndpointCollector):
         self.__dispatches = []
         self.__dispatches_lock = threading.Lock()
 
+        # Unprocessed per-kernel aggregates from tracers running in
+        # aggregation mode, as (gpu_id, kernel_name, count, total_duration)
+        # tuples. Guarded by the same lock as dispatches.
+        self.__aggregates = []
+
         # Accumulated metric values. Keys are tuples, values are lists:
         #   Keys: (gpu_id, kernel_name)
         #   Values: [num_dispatches, total_duration]
@@ -77,15 +179,52 @@ class KernelTrace(EndpointCollector):
         # strings which can be 600+ byte strings.
         self.__kernel_names = {}
 
+        # Kernel name dictionaries synced by tracers running in dictionary
+        # mode, keyed by (client, kernel_id). Kernel IDs are only unique
+        # within a process, so entries are scoped by the client identifier
+        # each tracer reports.
+        self.__kernel_dicts = {}
+
+        # Latest health counters pushed by each tracer on its periodic
+        # interval, keyed by client and timestamped (ms) at receipt. Entries
+        # from exited tracers age out after __health_ttl_ms.
+        self.__health = {}
+        self.__health_ttl_ms = 60_000
+
+        # Closed annotation-window roll-ups pushed by tracers, oldest first.
+        # Bounded so jobs cycling through many phases can't grow memory
+        # without limit; post-hoc consumers are expected to poll the GET
+        # route at a faster cadence than windows age out.
+        self.__windows = deque(maxlen=1_000)
+
         route("/kernel_trace", methods=["POST"])(self.handleRequest)
+        route("/kernel_trace/dict", methods=["POST"])(self.handleDictRequest)
+        route("/kernel_trace/health", methods=["POST"])(self.handleHealthRequest)
+        route("/kernel_trace/windows", methods=["GET"])(self.handleWindowsRequest)
 
     def handleRequest(self):
         try:
-            # Parse JSON array of arrays
-            records = orjson.loads(request.data)
+            client = 0
+            if request.content_type == BINARY_CONTENT_TYPE:
+                client, records = parse_binary_trace(request_payload())
+            else:
+                # Parse JSON array of arrays, or an object wrapping the array
+                # when the tracer runs in dictionary mode
+                records = orjson.loads(request_payload())
+                if isinstance(records, dict):
+                    client = records["client"]
+                    if "aggregate" in records:
+                        return self.handleAggregate(client, records["aggregate"])
+                    if "window" in records:
+                        return self.handleWindow(client, records["window"])
+                    records = records["records"]
 
             dispatches = []
             for gpu_id, kernel, start_ns, end_ns in records:
+                if isinstance(kernel, int):
+                    # Resolve dictionary IDs; records can outrun a failed
+                    # dictionary sync, in which case report a placeholder
+                    kernel = self.__kernel_dicts.get((client, kernel), f"unknown_kernel_{kernel}")
                 kernel_ref = self.__kernel_names.get(kernel)
                 if kernel_ref is None:
                     self.__kernel_names[kernel] = kernel
@@ -101,6 +240,98 @@ class KernelTrace(EndpointCollector):
         except Exception as e:
             return str(e), 400
 
+    def handleAggregate(self, client, entries):
+        """Consume per-kernel aggregate entries produced by tracers running
+        in aggregation mode: [gpu_id, kernel, count, total_ns, min_ns,
+        max_ns, [histogram buckets]]. Counts and total durations feed the
+        same time-series pipeline as raw dispatches; the distribution fields
+        are carried for downstream consumers and not exported here."""
+        aggregates = []
+        for gpu_id, kernel, count, total_ns, _min_ns, _max_ns, _buckets in entries:
+            if isinstance(kernel, int):
+                kernel = self.__kernel_dicts.get((client, kernel), f"unknown_kernel_{kernel}")
+            kernel_ref = self.__kernel_names.get(kernel)
+            if kernel_ref is None:
+                self.__kernel_names[kernel] = kernel
+                kernel_ref = kernel
+            aggregates.append((gpu_id, kernel_ref, count, total_ns))
+
+        with self.__dispatches_lock:
+            self.__aggregates.extend(aggregates)
+
+        return "", 204
+
+    def handleWindow(self, client, window):
+        """Consume a closed annotation-window roll-up: the window label, its
+        boundaries, and per-kernel aggregate entries in the same shape as
+        aggregation-mode payloads. GPU timestamps are converted to unix time
+        on receipt; windows are retained for the GET route rather than fed
+        into the time-series pipeline, since their dispatches already arrive
+        through the raw or aggregate path."""
+        kernels = []
+        for gpu_id, kernel, count, total_ns, min_ns, max_ns, buckets in window["kernels"]:
+            if isinstance(kernel, int):
+                kernel = self.__kernel_dicts.get((client, kernel), f"unknown_kernel_{kernel}")
+            kernels.append([gpu_id, kernel, count, total_ns, min_ns, max_ns, buckets])
+
+        self.__windows.append(
+            {
+                "client": client,
+                "annotation": window["annotation"],
+                "start_ns": window["start_ns"] + self.__offset_ns,
+                "end_ns": window["end_ns"] + self.__offset_ns,
+                "kernels": kernels,
+            }
+        )
+        return "", 204
+
+    def handleWindowsRequest(self):
+        """Serve the retained annotation-window roll-ups as JSON, newest
+        last, for post-hoc per-phase analysis."""
+        return orjson.dumps(list(self.__windows)), 200, {"Content-Type": "application/json"}
+
+    def handleDictRequest(self):
+        try:
+            payload = orjson.loads(request_payload())
+            client = payload["client"]
+            for kernel_id, name in payload["kernels"]:
+                name_ref = self.__kernel_names.get(name)
+                if name_ref is None:
+                    self.__kernel_names[name] = name
+                    name_ref = name
+                self.__kernel_dicts[(client, kernel_id)] = name_ref
+
+            return "", 204
+
+        except Exception as e:
+            return str(e), 400
+
+    def handleHealthRequest(self):
+        """Consume the live health counters tracers push on their periodic
+        flush interval: cumulative record/flush/drop totals, serialization
+        and POST time, sender queue depth, and a POST latency histogram"""
+        try:
+            payload = orjson.loads(request_payload())
+            health = payload["health"]
+
+            # Validate the shape before storing: the fields are indexed from
+            # inside the streaming scrape generator, where a malformed entry
+            # would abort every scrape until it ages out of the TTL
+            if not isinstance(health, dict):
+                raise ValueError("health payload is not an object")
+            for field in HEALTH_FIELDS:
+                if not isinstance(health.get(field), int):
+                    raise ValueError(f"missing or non-integer health field: {field}")
+            buckets = health.get("post_latency_us_buckets")
+            if not isinstance(buckets, list) or not all(isinstance(b, int) for b in buckets):
+                raise ValueError("post_latency_us_buckets is not a list of counts")
+
+            self.__health[payload["client"]] = (health, time.time_ns() // 1_000_000)
+            return "", 204
+
+        except Exception as e:
+            return str(e), 400
+
     def updateMetrics(self):
         logging.debug("Checking kernel tracing data...")
         self.__process_dispatches()
@@ -110,7 +341,27 @@ class KernelTrace(EndpointCollector):
         last_bin = self.__process_dispatches()
         cutoff = last_bin if flush else last_bin - self.__window_ms
         bins = self.__pop_bins(cutoff)
-        return self.__format_bins(bins, label_defaults)
+        yield from self.__format_bins(bins, label_defaults)
+        yield from self.__format_health(label_defaults)
+
+    def __format_health(self, label_defaults):
+        now_ms = time.time_ns() // 1_000_000
+        for client in list(self.__health):
+            health, received_ms = self.__health[client]
+            if now_ms - received_ms > self.__health_ttl_ms:
+                del self.__health[client]
+                continue
+
+            labels = f'{label_defaults},client="{client}"'
+            for field in HEALTH_FIELDS:
+                yield f"omnistat_kernel_tracer_{field}{{{labels}}} {health[field]} {received_ms}".encode()
+                yield b"\n"
+
+            buckets = health["post_latency_us_buckets"]
+            for quantile in (0.5, 0.95, 0.99):
+                value = latency_percentile(buckets, quantile)
+                yield f'omnistat_kernel_tracer_post_latency_ns{{{labels},quantile="{quantile}"}} {value} {received_ms}'.encode()
+                yield b"\n"
 
     def __pop_bins(self, cutoff_bin):
         num_pop = 0
@@ -153,6 +404,7 @@ class KernelTrace(EndpointCollector):
             int: The last (most recent) bin in the time series (in ms).
         """
         dispatches = []
+        aggregates = []
 
         time_ms = time.time_ns() // 1_000_000
         current_bin = ((time_ms // self.__interval_ms) + 1) * self.__interval_ms
@@ -169,10 +421,12 @@ class KernelTrace(EndpointCollector):
             self.__ts[i] = {}
             last_bin = i
 
-        if len(self.__dispatches) > 0:
+        if len(self.__dispatches) > 0 or len(self.__aggregates) > 0:
             with self.__dispatches_lock:
                 dispatches = self.__dispatches
                 self.__dispatches = []
+                aggregates = self.__aggregates
+                self.__aggregates = []
 
         for gpu_id, name, end_ns, duration_ns in dispatches:
             end_ms = (end_ns + self.__offset_ns) // 1_000_000
@@ -189,4 +443,13 @@ class KernelTrace(EndpointCollector):
             value[1] += duration_ns
             self.__ts[end_bin][key] = value[:]
 
+        # Aggregates cover the tracer's previous flush interval and carry no
+        # per-dispatch timestamps; attribute them to the current bin.
+        for gpu_id, name, count, total_ns in aggregates:
+            key = (gpu_id, name)
+            value = self.__values[key]
+            value[0] += count
+            value[1] += total_ns
+            self.__ts[last_bin][key] = value[:]
+
         return last_bin
@@ -46,9 +46,10 @@ import sys
 from prometheus_client import Gauge, generate_latest
 
 from omnistat.collector_base import Collector
+from omnistat.shm_metrics import ShmMetricsReader
 
 try:
-    from omnistat.rocprofiler_sdk_extension import get_samplers, initialize
+    from omnistat.rocprofiler_sdk_extension import enable_shm_metrics, get_samplers, initialize, sample_all
 except ModuleNotFoundError as e:
     logging.error(f"Missing ROCProfiler-SDK extension: build with installation required")
     sys.exit(4)
@@ -72,10 +73,15 @@ class rocprofiler_sdk(Collector):
         counters = None
         mode = "constant"
 
+        shm_path = None
+        shm_interval_ms = 100
+
         rocprofiler_section_path = "omnistat.collectors.rocprofiler"
         if config.has_section(rocprofiler_section_path):
             section = config[rocprofiler_section_path]
             profile = section.get("profile", profile)
+            shm_path = section.get("shm_metrics_path", shm_path)
+            shm_interval_ms = section.getint("shm_sample_interval_ms", shm_interval_ms)
 
         profile_section_path = f"omnistat.collectors.rocprofiler.{profile}"
         if config.has_section(profile_section_path):
@@ -115,9 +121,15 @@ class rocprofiler_sdk(Collector):
             logging.error('ERROR: "gpu-id" sampling mode requires multiple sets of counters')
             sys.exit(4)
 
+        if shm_path and mode == "periodic":
+            logging.error('ERROR: "shm_metrics_path" is not supported with "periodic" sampling')
+            sys.exit(4)
+
         self.__samplers = get_samplers()
         self.__mode = mode
         self.__metric = None
+        self.__shm_reader = None
+        self.__shm_previous = {}
 
         if self.__mode in ["constant", "gpu-id"]:
             self.__update_method = self.updateMetricsConstant
@@ -129,8 +141,19 @@ class rocprofiler_sdk(Collector):
                 self.__names.append(counters[i % len(counters)])
 
             try:
-                for i, sampler in enumerate(self.__samplers):
-                    sampler.start(self.__names[i])
+                if shm_path:
+                    # Sampling runs on free-running C++ threads that publish
+                    # into a shared-memory segment; a scrape then reads the
+                    # mapped segment instead of calling into the extension.
+                    for i, sampler in enumerate(self.__samplers):
+                        sampler.start_periodic(self.__names[i], shm_interval_ms)
+                    enable_shm_metrics(shm_path)
+                    self.__shm_reader = ShmMetricsReader(shm_path)
+                    self.__update_method = self.updateMetricsShm
+                    logging.info(f"Shared metrics segment = {shm_path} ({shm_interval_ms} ms)")
+                else:
+                    for i, sampler in enumerate(self.__samplers):
+                        sampler.start(self.__names[i])
             except Exception as e:
                 logging.error(f"ERROR: {e}")
                 sys.exit(4)
@@ -183,15 +206,24 @@ class rocprofiler_sdk(Collector):
         self.__update_method()
 
     def updateMetricsConstant(self):
-        for i, sampler in enumerate(self.__samplers):
-            values = sampler.sample()
+        # All devices are sampled concurrently from C++ with the GIL released
+        for i, values in enumerate(sample_all()):
             for j, name in enumerate(self.__names[i]):
                 self.__metric.labels("gpu", i, name).set(values[j])
         return
 
+    def updateMetricsShm(self):
+        # Values in the segment are cumulative totals published by the C++
+        # sampling threads; report the activity since the previous scrape to
+        # match what the direct sampling path exposes.
+        for device, name, value in self.__shm_reader.read():
+            previous = self.__shm_previous.get((device, name), 0.0)
+            self.__shm_previous[(device, name)] = value
+            self.__metric.labels("gpu", device, name).set(value - previous)
+        return
+
     def updateMetricsPeriodic(self):
-        for i, sampler in enumerate(self.__samplers):
-            values = sampler.sample()
+        for i, values in enumerate(sample_all()):
             for j, name in enumerate(self.__names[self.__current_set]):
                 self.__metric.labels("gpu", i, name).set(values[j])
 
@@ -100,8 +100,17 @@ def main():
         app.route("/shutdown")(shutdown)
 
     listenPort = config["omnistat.collectors"].get("port", 8001)
+    binds = ["%s:%s" % ("0.0.0.0", listenPort)]
+
+    # Optionally listen on a Unix domain socket as well, allowing local
+    # clients like the kernel tracing library (OMNISTAT_TRACE_SOCKET) to
+    # bypass the loopback TCP stack.
+    listenSocket = config["omnistat.collectors"].get("socket", None)
+    if listenSocket:
+        binds.append("unix:%s" % listenSocket)
+
     options = {
-        "bind": "%s:%s" % ("0.0.0.0", listenPort),
+        "bind": binds,
         "workers": 1,
         "post_fork": post_fork,
     }
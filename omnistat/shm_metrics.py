@@ -0,0 +1,100 @@
+# -------------------------------------------------------------------------------
+# MIT License
+#
+# Copyright (c) 2023 - 2026 Advanced Micro Devices, Inc. All Rights Reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+# -------------------------------------------------------------------------------
+
+"""Reader for the ROCProfiler-SDK extension's shared-memory metrics segment
+
+The extension's ``enable_shm_metrics()`` publishes each sampler's cumulative
+counter totals into a fixed-layout file (typically under ``/dev/shm``): a
+64-byte header followed by one 64-byte slot per metric, each slot guarded by
+its own sequence counter so values can be read without locks. This module is
+the matching reader — map the segment once, then each read is a handful of
+struct unpacks with no extension, SDK, or RPC involvement.
+
+Layout (little-endian):
+    header: magic u32, version u32, num_slots u32, num_devices u32, pad to 64
+    slot:   seq u64, value f64, device u32, name char[40], pad to 64
+"""
+
+import mmap
+import os
+import struct
+
+SHM_METRICS_MAGIC = 0x4D534D4F  # "OMSM"
+SHM_METRICS_VERSION = 1
+
+_HEADER_SIZE = 64
+_SLOT_SIZE = 64
+_NAME_OFFSET = 20
+_NAME_SIZE = 40
+
+
+class ShmMetricsReader:
+    """Maps a shared metrics segment and reads consistent value snapshots"""
+
+    def __init__(self, path):
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            size = os.fstat(fd).st_size
+            self._map = mmap.mmap(fd, size, prot=mmap.PROT_READ)
+        finally:
+            os.close(fd)
+
+        magic, version, num_slots, self.num_devices = struct.unpack_from("<IIII", self._map, 0)
+        if magic != SHM_METRICS_MAGIC:
+            raise ValueError(f"Not a shared metrics segment: {path}")
+        if version != SHM_METRICS_VERSION:
+            raise ValueError(f"Unsupported shared metrics segment version: {version}")
+
+        # Device indices and names are fixed for the lifetime of the segment,
+        # so decode them once; reads only touch each slot's seq and value.
+        self._slots = []
+        for i in range(num_slots):
+            base = _HEADER_SIZE + i * _SLOT_SIZE
+            (device,) = struct.unpack_from("<I", self._map, base + 16)
+            raw = self._map[base + _NAME_OFFSET : base + _NAME_OFFSET + _NAME_SIZE]
+            name = raw.split(b"\0", 1)[0].decode()
+            self._slots.append((base, device, name))
+
+    def read(self):
+        """Return a (device, name, value) tuple per metric
+
+        Values are the publisher's cumulative totals. Each slot is re-read if
+        its sequence counter changed mid-copy, which the writer's cadence
+        makes vanishingly rare.
+        """
+        values = []
+        for base, device, name in self._slots:
+            while True:
+                (seq,) = struct.unpack_from("<Q", self._map, base)
+                if seq & 1:
+                    continue
+                (value,) = struct.unpack_from("<d", self._map, base + 8)
+                (check,) = struct.unpack_from("<Q", self._map, base)
+                if check == seq:
+                    break
+            values.append((device, name, value))
+        return values
+
+    def close(self):
+        self._map.close()
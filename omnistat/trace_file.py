@@ -0,0 +1,140 @@
+# -------------------------------------------------------------------------------
+# MIT License
+#
+# Copyright (c) 2023 - 2026 Advanced Micro Devices, Inc. All Rights Reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+# -------------------------------------------------------------------------------
+
+"""Reader for local kernel trace files written by the tracing library
+
+Endpoint-less runs of the kernel tracing library (OMNISTAT_TRACE_FILE, see
+rocprofiler-sdk/trace_file.hpp) append page-aligned blocks of binary dispatch
+records and close the file with a footer index of per-block time ranges. This
+reader maps the file and uses the index to decode only the blocks overlapping
+a requested time slice, so loading a few minutes out of a multi-hour job
+never touches the rest of the file.
+
+Layout (little-endian):
+    file header:  magic "OMTF", version u8, pad[3], page size u32
+    block:        magic "OMTB", payload bytes u32, record count u32,
+                  reserved u32, min/max timestamp u64, then a binary trace
+                  payload as produced for the HTTP endpoint
+    footer:       index entries (offset u64, payload bytes u32, record count
+                  u32, min/max timestamp u64), then a trailer (index offset
+                  u64, entry count u64, reserved u32, magic "OMTX")
+"""
+
+import mmap
+import os
+import struct
+
+FILE_MAGIC = b"OMTF"
+TRAILER_MAGIC = b"OMTX"
+FILE_VERSION = 1
+
+_BLOCK_HEADER = struct.Struct("<4sIIIQQ")
+_INDEX_ENTRY = struct.Struct("<QIIQQ")
+_TRAILER = struct.Struct("<QQI4s")
+
+# Binary trace payload format, mirroring rocprofiler-sdk/trace_format.hpp
+# (the same constants live in collector_kernel_trace.py, which depends on
+# flask and is not importable from query-side tooling)
+_PAYLOAD_HEADER = struct.Struct("<4sBBHII")
+_PAYLOAD_RECORD = struct.Struct("<IIQQ")
+PAYLOAD_MAGIC = b"OMTR"
+
+
+def _parse_payload_records(data):
+    """Yield (gpu_id, kernel, start_ns, end_ns) tuples from one binary trace
+    payload as stored in a block"""
+    magic, version, _, _, num_records, _ = _PAYLOAD_HEADER.unpack_from(data, 0)
+    if magic != PAYLOAD_MAGIC:
+        raise ValueError(f"unexpected trace payload magic: {magic}")
+
+    offset = _PAYLOAD_HEADER.size
+    for _ in range(num_records):
+        gpu_id, name_length, start_ns, end_ns = _PAYLOAD_RECORD.unpack_from(data, offset)
+        offset += _PAYLOAD_RECORD.size
+        name = data[offset : offset + name_length].decode()
+        offset += name_length
+        yield (gpu_id, name, start_ns, end_ns)
+
+
+class TraceFileReader:
+    """Maps a trace file and loads dispatch records by time slice"""
+
+    def __init__(self, path):
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            size = os.fstat(fd).st_size
+            self._map = mmap.mmap(fd, size, prot=mmap.PROT_READ)
+        finally:
+            os.close(fd)
+
+        if self._map[:4] != FILE_MAGIC:
+            raise ValueError(f"not an omnistat trace file: {path}")
+        if self._map[4] != FILE_VERSION:
+            raise ValueError(f"unsupported trace file version: {self._map[4]}")
+
+        index_offset, num_entries, _, magic = _TRAILER.unpack_from(self._map, size - _TRAILER.size)
+        if magic != TRAILER_MAGIC:
+            raise ValueError(f"missing trace file trailer (incomplete write?): {path}")
+
+        # Footer index: (offset, payload_bytes, record_count, min_ns, max_ns)
+        # per block, in append order
+        self.index = [
+            _INDEX_ENTRY.unpack_from(self._map, index_offset + i * _INDEX_ENTRY.size)
+            for i in range(num_entries)
+        ]
+
+    @property
+    def num_records(self):
+        return sum(entry[2] for entry in self.index)
+
+    def time_range(self):
+        """Return (min_ns, max_ns) covered by the file, or None when empty"""
+        if not self.index:
+            return None
+        return (min(entry[3] for entry in self.index), max(entry[4] for entry in self.index))
+
+    def records(self, start_ns=None, end_ns=None):
+        """Yield (gpu_id, kernel, start_ns, end_ns) tuples for dispatches
+        overlapping [start_ns, end_ns], using the footer index to skip blocks
+        entirely outside the slice"""
+        for offset, payload_bytes, _, block_min, block_max in self.index:
+            if start_ns is not None and block_max < start_ns:
+                continue
+            if end_ns is not None and block_min > end_ns:
+                continue
+
+            header = _BLOCK_HEADER.unpack_from(self._map, offset)
+            if header[0] != b"OMTB" or header[1] != payload_bytes:
+                raise ValueError(f"corrupt block header at offset {offset}")
+
+            payload = self._map[offset + _BLOCK_HEADER.size : offset + _BLOCK_HEADER.size + payload_bytes]
+            for record in _parse_payload_records(payload):
+                if start_ns is not None and record[3] < start_ns:
+                    continue
+                if end_ns is not None and record[2] > end_ns:
+                    continue
+                yield record
+
+    def close(self):
+        self._map.close()
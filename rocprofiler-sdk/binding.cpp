@@ -25,6 +25,7 @@
 #include "device.hpp"
 
 #include <nanobind/nanobind.h>
+#include <nanobind/ndarray.h>
 #include <nanobind/stl/bind_vector.h>
 #include <nanobind/stl/shared_ptr.h>
 #include <nanobind/stl/string.h>
@@ -38,14 +39,63 @@ NB_MODULE(rocprofiler_sdk_extension, m) {
     m.def("initialize", &omnistat::initialize);
 
     nb::bind_vector<std::vector<std::string>>(m, "StringList");
+    nb::bind_vector<std::vector<std::vector<std::string>>>(m, "StringListList");
     nb::bind_vector<std::vector<double>>(m, "DoubleList");
+    nb::bind_vector<std::vector<uint64_t>>(m, "UIntList");
 
     nb::class_<omnistat::DeviceSampler>(m, "DeviceSampler")
         .def("start", &omnistat::DeviceSampler::start, "counters"_a)
-        .def("sample", &omnistat::DeviceSampler::sample)
-        .def("stop", &omnistat::DeviceSampler::stop);
+        // Free-running background sampling; sample() then reads the latest
+        // snapshot without blocking on the SDK or the GIL-released workers
+        .def("start_periodic", &omnistat::DeviceSampler::start_periodic, "counters"_a,
+             "interval_ms"_a)
+        // Zero-copy numpy view over the sampler's persistent output buffer;
+        // the view is overwritten by the next sample() and keeps the sampler
+        // alive through the owner handle
+        .def("sample",
+             [](nb::object self) {
+                 auto& sampler = nb::cast<omnistat::DeviceSampler&>(self);
+                 const auto& values = sampler.sample();
+                 return nb::ndarray<nb::numpy, const double, nb::ndim<1>>(
+                     values.data(), {values.size()}, self);
+             })
+        // Per-instance values, counter-major and instance-minor; same
+        // zero-copy view semantics as sample()
+        .def("sample_detailed",
+             [](nb::object self) {
+                 auto& sampler = nb::cast<omnistat::DeviceSampler&>(self);
+                 const auto& values = sampler.sample_detailed();
+                 return nb::ndarray<nb::numpy, const double, nb::ndim<1>>(
+                     values.data(), {values.size()}, self);
+             })
+        .def("instance_counts", &omnistat::DeviceSampler::instance_counts)
+        .def("set_derived_metrics", &omnistat::DeviceSampler::set_derived_metrics,
+             "definitions"_a)
+        // Derived values in registration order, evaluated in C++ from the
+        // compiled expression plans; same view semantics as sample()
+        .def("sample_derived",
+             [](nb::object self) {
+                 auto& sampler = nb::cast<omnistat::DeviceSampler&>(self);
+                 const auto& values = sampler.sample_derived();
+                 return nb::ndarray<nb::numpy, const double, nb::ndim<1>>(
+                     values.data(), {values.size()}, self);
+             })
+        .def("stop", &omnistat::DeviceSampler::stop)
+        .def("start_multiplexed", &omnistat::DeviceSampler::start_multiplexed,
+             "counter_groups"_a, "samples_per_group"_a = 1)
+        .def("sampled_groups", &omnistat::DeviceSampler::sampled_groups)
+        .def("current_group", &omnistat::DeviceSampler::current_group);
 
     nb::bind_vector<std::vector<std::shared_ptr<omnistat::DeviceSampler>>>(m, "DeviceSamplerList");
+    nb::bind_vector<std::vector<std::vector<double>>>(m, "DoubleListList");
 
     m.def("get_samplers", &omnistat::get_samplers);
+
+    // Samples all devices concurrently from C++ threads; the GIL is released
+    // for the duration so one scrape costs the slowest device, not the sum
+    m.def("sample_all", &omnistat::sample_all, nb::call_guard<nb::gil_scoped_release>());
+
+    // Publish sampled values into a fixed-layout shared-memory segment
+    // readable without the extension (see omnistat/shm_metrics.py)
+    m.def("enable_shm_metrics", &omnistat::enable_shm_metrics, "path"_a);
 }
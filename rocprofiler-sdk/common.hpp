@@ -51,8 +51,10 @@
 namespace omnistat {
 
 // Helper function to parse an unsigned integer from an environment variable
-// Returns the value, defaulting to default_value if invalid or not set
-uint64_t parse_env_uint(const char* env_var_name, uint64_t default_value) {
+// Returns the value, defaulting to default_value if invalid or not set. Zero
+// is rejected unless allow_zero is set, for variables where it is meaningful
+// (e.g. disabling a feature).
+uint64_t parse_env_uint(const char* env_var_name, uint64_t default_value, bool allow_zero = false) {
     const char* env_value = std::getenv(env_var_name);
 
     if (env_value == nullptr) {
@@ -61,7 +63,7 @@ uint64_t parse_env_uint(const char* env_var_name, uint64_t default_value) {
 
     try {
         uint64_t value = std::stoull(env_value);
-        if (value > 0) {
+        if (value > 0 || allow_zero) {
             return value;
         }
     } catch (const std::exception&) {
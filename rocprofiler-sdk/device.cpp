@@ -27,8 +27,14 @@
 
 #include <hsa/hsa.h>
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <string_view>
+#include <thread>
 
 namespace omnistat {
 
@@ -41,13 +47,60 @@ const std::vector<std::shared_ptr<DeviceSampler>>& get_samplers() {
     return samplers;
 }
 
+// Process-wide shared metrics segment; immortal like the sampler registry so
+// publishing threads never race its destruction during interpreter teardown
+static ShmMetricsSegment* shm_metrics = nullptr;
+
+void enable_shm_metrics(const std::string& path) {
+    std::vector<std::vector<std::string>> names;
+    names.reserve(samplers.size());
+    for (const auto& sampler : samplers) {
+        names.push_back(sampler->active_counters());
+    }
+
+    auto* segment = new ShmMetricsSegment();
+    segment->create(path, names);
+    shm_metrics = segment;
+
+    for (size_t i = 0; i < samplers.size(); i++) {
+        samplers[i]->attach_shm(segment, i);
+    }
+}
+
+std::vector<std::vector<double>> sample_all() {
+    std::vector<std::vector<double>> results(samplers.size());
+    std::vector<std::exception_ptr> errors(samplers.size());
+    std::vector<std::thread> workers;
+    workers.reserve(samplers.size());
+
+    for (size_t i = 0; i < samplers.size(); i++) {
+        workers.emplace_back([i, &results, &errors]() {
+            try {
+                results[i] = samplers[i]->sample();
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    return results;
+}
+
 // Initialization required to use the extension. ROCProfiler-SDK normally expects to be loaded as
 // part of an application with GPU code, e.g. HIP. This Python extension doesn't execute anything in
-// the GPU, so we need to force its initialization. HSA also needs to be initialized to set up the
-// right queues for device profiling.
+// the GPU, so we need to force its initialization. HSA initialization is deferred until the first
+// sampler is started — see DeviceSampler::configure_service().
 void initialize() {
     ROCPROFILER_CALL(rocprofiler_force_configure(&rocprofiler_configure), "configure rocprofiler");
-    hsa_init();
 }
 
 // Calculate the size of a given counter based on its dimensions. GPU counters aren't simple
@@ -71,9 +124,20 @@ size_t get_counter_size(rocprofiler_counter_id_t counter) {
 
 DeviceSampler::DeviceSampler(rocprofiler_agent_id_t agent) : agent_(agent) {
     ROCPROFILER_CALL(rocprofiler_create_context(&ctx_), "create context");
+}
+
+// Configure the device counting service on first activation. Service setup
+// is the expensive part of bringing an agent up, so deferring it means a
+// collector monitoring two GPUs on an eight-GPU node configures two.
+void DeviceSampler::configure_service() {
+    // HSA needs to be initialized to set up the right queues for device
+    // profiling; deferred alongside the service so constructing samplers
+    // stays cheap on startup
+    static std::once_flag hsa_once;
+    std::call_once(hsa_once, []() { hsa_init(); });
 
     ROCPROFILER_CALL(rocprofiler_configure_device_counting_service(
-                         ctx_, rocprofiler_buffer_id_t{.handle = 0}, agent,
+                         ctx_, rocprofiler_buffer_id_t{.handle = 0}, agent_,
                          [](rocprofiler_context_id_t context_id, rocprofiler_agent_id_t,
                             rocprofiler_agent_set_profile_callback_t set_config, void* user_data) {
                              if (user_data) {
@@ -83,6 +147,7 @@ DeviceSampler::DeviceSampler(rocprofiler_agent_id_t agent) : agent_(agent) {
                          },
                          this),
                      "device counting service");
+    service_configured_ = true;
 }
 
 void DeviceSampler::set_profile(rocprofiler_context_id_t ctx,
@@ -92,13 +157,28 @@ void DeviceSampler::set_profile(rocprofiler_context_id_t ctx,
     }
 }
 
-std::unordered_map<std::string, rocprofiler_counter_id_t>
-DeviceSampler::get_supported_counters() const {
+// Catalog of supported counters per agent, mapping counter names to IDs.
+// Enumerating counters is expensive — a full agent walk plus one
+// rocprofiler_query_counter_info per counter, hundreds of counters on recent
+// GPUs — so the catalog is built lazily on first use and shared across all
+// DeviceSampler instances and profiles for the same agent.
+static const std::unordered_map<std::string, rocprofiler_counter_id_t>&
+get_counter_catalog(rocprofiler_agent_id_t agent) {
+    static std::mutex catalog_mutex;
+    static std::unordered_map<uint64_t, std::unordered_map<std::string, rocprofiler_counter_id_t>>
+        catalogs;
+
+    std::lock_guard<std::mutex> lock(catalog_mutex);
+    auto cached = catalogs.find(agent.handle);
+    if (cached != catalogs.end()) {
+        return cached->second;
+    }
+
     std::unordered_map<std::string, rocprofiler_counter_id_t> out;
     std::vector<rocprofiler_counter_id_t> gpu_counters;
 
     ROCPROFILER_CALL(rocprofiler_iterate_agent_supported_counters(
-                         agent_,
+                         agent,
                          [](rocprofiler_agent_id_t, rocprofiler_counter_id_t* counters,
                             size_t num_counters, void* user_data) {
                              std::vector<rocprofiler_counter_id_t>* vec =
@@ -117,26 +197,182 @@ DeviceSampler::get_supported_counters() const {
                          "query counter");
         out.emplace(version.name, counter);
     }
-    return out;
+
+    return catalogs.emplace(agent.handle, std::move(out)).first->second;
 }
 
 void DeviceSampler::start(const std::vector<std::string>& counters) {
+    if (periodic_thread_.joinable()) {
+        throw std::runtime_error("Stop periodic sampling before restarting the sampler");
+    }
+    multiplex_groups_.clear();
+    multiplex_outputs_.clear();
+    activate(counters);
+
+    // Revalidate registered derived metrics against the new profile so a
+    // stale reference fails here rather than from a later sample call
+    if (!derived_definitions_.empty()) {
+        has_previous_ = false;
+        compile_derived(true);
+    }
+}
+
+void DeviceSampler::start_periodic(const std::vector<std::string>& counters,
+                                   uint64_t interval_ms) {
+    if (interval_ms == 0) {
+        throw std::runtime_error("Periodic sampling requires a non-zero interval");
+    }
+
+    start(counters);
+
+    periodic_interval_ms_ = interval_ms;
+    periodic_totals_.assign(output_.size(), 0.0);
+    periodic_last_read_.assign(output_.size(), 0.0);
+    snapshot_values_[0].assign(output_.size(), 0.0);
+    snapshot_values_[1].assign(output_.size(), 0.0);
+    snapshot_seq_[0].store(0, std::memory_order_relaxed);
+    snapshot_seq_[1].store(0, std::memory_order_relaxed);
+    snapshot_latest_.store(0, std::memory_order_relaxed);
+    periodic_stop_.store(false, std::memory_order_release);
+    periodic_thread_ = std::thread(&DeviceSampler::periodic_loop, this);
+}
+
+void DeviceSampler::attach_shm(ShmMetricsSegment* segment, size_t device) {
+    shm_device_ = device;
+    shm_totals_.assign(output_.size(), 0.0);
+    shm_segment_.store(segment, std::memory_order_release);
+}
+
+// Free-running sampler body: one SDK read per interval, accumulated into
+// cumulative totals and published through the seqlock. Only this thread
+// touches records_ and the SDK while it runs, so it shares the slot-table
+// machinery with the direct path without synchronization.
+void DeviceSampler::periodic_loop() {
+    auto next = std::chrono::steady_clock::now();
+    size_t slot = 1;
+
+    while (!periodic_stop_.load(std::memory_order_acquire)) {
+        size_t size = records_.size();
+        rocprofiler_sample_device_counting_service(ctx_, {}, ROCPROFILER_COUNTER_FLAG_NONE,
+                                                   records_.data(), &size);
+
+        auto& slots = profile_slots_[profile_.handle];
+        if (slots.size() != records_.size()) {
+            build_slot_table(slots);
+        }
+        for (size_t i = 0; i < records_.size(); i++) {
+            if (slots[i] == SKIP_SLOT) {
+                continue;
+            }
+            periodic_totals_[slots[i]] += records_[i].counter_value;
+        }
+
+        // Cumulative totals go straight into the shared segment as well, so
+        // external readers track activity at the sampling cadence
+        if (auto* segment = shm_segment_.load(std::memory_order_acquire)) {
+            segment->publish(shm_device_, periodic_totals_);
+        }
+
+        // Seqlock publish: odd sequence marks the slot mid-write; the copy
+        // assignment never reallocates because both sides keep equal sizes
+        uint64_t seq = snapshot_seq_[slot].load(std::memory_order_relaxed);
+        snapshot_seq_[slot].store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        snapshot_values_[slot] = periodic_totals_;
+        snapshot_seq_[slot].store(seq + 2, std::memory_order_release);
+        snapshot_latest_.store(slot, std::memory_order_release);
+        slot ^= 1;
+
+        // Sleep in short steps so stop() never waits a full interval
+        next += std::chrono::milliseconds(periodic_interval_ms_);
+        while (!periodic_stop_.load(std::memory_order_acquire)) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next) {
+                break;
+            }
+            std::this_thread::sleep_until(std::min(next, now + std::chrono::milliseconds(10)));
+        }
+    }
+}
+
+// Wait-free latest-snapshot read: copy the most recently published slot and
+// retry only if a write overlapped the copy
+void DeviceSampler::read_snapshot(std::vector<double>& out) const {
+    while (true) {
+        size_t slot = snapshot_latest_.load(std::memory_order_acquire);
+        uint64_t begin = snapshot_seq_[slot].load(std::memory_order_acquire);
+        if (begin & 1) {
+            continue;
+        }
+        out = snapshot_values_[slot];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (snapshot_seq_[slot].load(std::memory_order_relaxed) == begin) {
+            return;
+        }
+    }
+}
+
+void DeviceSampler::start_multiplexed(const std::vector<std::vector<std::string>>& counter_groups,
+                                      uint64_t samples_per_group) {
+    if (periodic_thread_.joinable()) {
+        throw std::runtime_error("Stop periodic sampling before restarting the sampler");
+    }
+    if (counter_groups.empty()) {
+        throw std::runtime_error("Multiplexing requires at least one counter group");
+    }
+    if (samples_per_group == 0) {
+        throw std::runtime_error("Multiplexing requires at least one sample per group");
+    }
+
+    // Create every profile up front so rotating later never pays counter
+    // enumeration or profile creation, only a context stop/start
+    for (const auto& group : counter_groups) {
+        activate(group);
+        ROCPROFILER_CALL(rocprofiler_stop_context(ctx_), "stop context");
+    }
+
+    multiplex_groups_ = counter_groups;
+    multiplex_outputs_.assign(counter_groups.size(), {});
+    multiplex_interval_ = samples_per_group;
+    multiplex_count_ = 0;
+    multiplex_current_ = 0;
+    activate(multiplex_groups_[multiplex_current_]);
+
+    // Revalidate registered derived metrics against every group up front;
+    // counters owned by inactive groups evaluate as NaN until their group
+    // rotates in, while fully unknown counters fail here
+    if (!derived_definitions_.empty()) {
+        has_previous_ = false;
+        compile_derived(true);
+    }
+}
+
+// Switch to a (possibly cached) profile for the given counters and start the
+// context; shared by plain and multiplexed starts
+void DeviceSampler::activate(const std::vector<std::string>& counters) {
+    if (!service_configured_) {
+        configure_service();
+    }
+
     rocprofiler_profile_config_id_t profile = {};
     std::size_t profile_size = 0;
 
     auto cached_profile = cached_profiles_.find(counters);
     if (cached_profile == cached_profiles_.end()) {
         std::vector<rocprofiler_counter_id_t> counter_ids;
+        std::vector<uint64_t> instance_counts;
 
-        auto supported_counters = get_supported_counters();
+        const auto& supported_counters = get_counter_catalog(agent_);
         for (const auto& counter : counters) {
             auto it = supported_counters.find(counter);
             if (it == supported_counters.end()) {
                 throw std::runtime_error("Unsupported counter: " + counter);
             }
 
-            profile_size += get_counter_size(it->second);
+            auto counter_size = get_counter_size(it->second);
+            profile_size += counter_size;
             counter_ids.push_back(it->second);
+            instance_counts.push_back(counter_size);
         }
 
         ROCPROFILER_CALL(rocprofiler_create_profile_config(agent_, counter_ids.data(),
@@ -146,42 +382,439 @@ void DeviceSampler::start(const std::vector<std::string>& counters) {
         cached_profiles_.emplace(counters, profile);
         profile_sizes_.emplace(profile.handle, profile_size);
         profile_counter_ids_.emplace(profile.handle, counter_ids);
+        profile_instance_counts_.emplace(profile.handle, std::move(instance_counts));
     } else {
         profile = cached_profile->second;
         profile_size = profile_sizes_[profile.handle];
     }
 
     profile_ = profile;
+    active_counters_ = counters;
     records_.resize(profile_size);
+    output_.resize(profile_counter_ids_[profile.handle].size());
+    detailed_output_.resize(profile_size);
     ROCPROFILER_CALL(rocprofiler_start_context(ctx_), "start context");
 }
 
 void DeviceSampler::stop() {
+    if (periodic_thread_.joinable()) {
+        periodic_stop_.store(true, std::memory_order_release);
+        periodic_thread_.join();
+        periodic_interval_ms_ = 0;
+    }
     ROCPROFILER_CALL(rocprofiler_stop_context(ctx_), "stop context");
 }
 
-std::vector<double> DeviceSampler::sample() {
-    std::vector<double> result;
-    std::unordered_map<rocprofiler_counter_instance_id_t, double> aggregate;
+// Map each record index to the output slot of its counter. Record instance
+// IDs are fixed once a profile is created, so this runs once per profile,
+// paying the per-record rocprofiler_query_record_counter_id exactly once.
+void DeviceSampler::build_slot_table(std::vector<size_t>& slots) const {
+    const auto& counter_ids = profile_counter_ids_.at(profile_.handle);
 
+    std::unordered_map<uint64_t, size_t> slot_by_counter;
+    for (size_t i = 0; i < counter_ids.size(); i++) {
+        slot_by_counter.emplace(counter_ids[i].handle, i);
+    }
+
+    slots.assign(records_.size(), SKIP_SLOT);
+    rocprofiler_counter_id_t counter_id = {.handle = 0};
+    for (size_t i = 0; i < records_.size(); i++) {
+        rocprofiler_query_record_counter_id(records_[i].id, &counter_id);
+        auto it = slot_by_counter.find(counter_id.handle);
+        if (it != slot_by_counter.end()) {
+            slots[i] = it->second;
+        }
+    }
+}
+
+// Map each record index to its position in the detailed buffer: counters in
+// requested order, each occupying a contiguous run of its dimension
+// instances. Instances keep the order the SDK reports records in, which is
+// stable for the lifetime of a profile.
+void DeviceSampler::build_detailed_slot_table(std::vector<size_t>& slots) const {
+    const auto& counter_ids = profile_counter_ids_.at(profile_.handle);
+    const auto& instance_counts = profile_instance_counts_.at(profile_.handle);
+
+    // Next free position of each counter's run, advanced as records claim it
+    std::unordered_map<uint64_t, size_t> positions;
+    size_t offset = 0;
+    for (size_t i = 0; i < counter_ids.size(); i++) {
+        positions.emplace(counter_ids[i].handle, offset);
+        offset += instance_counts[i];
+    }
+
+    slots.assign(records_.size(), SKIP_SLOT);
+    rocprofiler_counter_id_t counter_id = {.handle = 0};
+    for (size_t i = 0; i < records_.size(); i++) {
+        rocprofiler_query_record_counter_id(records_[i].id, &counter_id);
+        auto it = positions.find(counter_id.handle);
+        if (it != positions.end()) {
+            slots[i] = it->second++;
+        }
+    }
+}
+
+const std::vector<double>& DeviceSampler::sample_detailed() {
     size_t size = records_.size();
     rocprofiler_sample_device_counting_service(ctx_, {}, ROCPROFILER_COUNTER_FLAG_NONE,
                                                records_.data(), &size);
 
+    auto& slots = profile_detailed_slots_[profile_.handle];
+    if (slots.size() != records_.size()) {
+        build_detailed_slot_table(slots);
+    }
+
+    std::fill(detailed_output_.begin(), detailed_output_.end(), 0.0);
+    for (size_t i = 0; i < records_.size(); i++) {
+        if (slots[i] == SKIP_SLOT) {
+            continue;
+        }
+        detailed_output_[slots[i]] = records_[i].counter_value;
+    }
+
+    return detailed_output_;
+}
+
+// Recursive-descent compiler for derived-metric expressions, emitting a flat
+// postfix program. Grammar:
+//   expr   := term (('+' | '-') term)*
+//   term   := factor (('*' | '/') factor)*
+//   factor := NUMBER | COUNTER | 'delta' '(' COUNTER ')' | 'dt' '(' ')'
+//           | '(' expr ')' | '-' factor
+class DerivedExpressionCompiler {
+  public:
+    // Counter references resolve to slots of `counters`, the active profile.
+    // References missing from it compile to DERIVED_ABSENT_SLOT and evaluate
+    // as NaN — unless `known` is given, in which case names missing from
+    // that list too are compile errors (fail-fast validation at setup).
+    DerivedExpressionCompiler(std::string_view expression,
+                              const std::vector<std::string>& counters,
+                              const std::vector<std::string>* known = nullptr)
+        : expression_(expression), counters_(counters), known_(known) {}
+
+    std::vector<DerivedOp> compile() {
+        std::vector<DerivedOp> ops;
+        parse_expr(ops);
+        skip_spaces();
+        if (pos_ != expression_.size()) {
+            fail("unexpected trailing input");
+        }
+        return ops;
+    }
+
+  private:
+    void parse_expr(std::vector<DerivedOp>& ops) {
+        parse_term(ops);
+        while (true) {
+            skip_spaces();
+            if (consume('+')) {
+                parse_term(ops);
+                ops.push_back({DerivedOp::Kind::Add});
+            } else if (consume('-')) {
+                parse_term(ops);
+                ops.push_back({DerivedOp::Kind::Sub});
+            } else {
+                break;
+            }
+        }
+    }
+
+    void parse_term(std::vector<DerivedOp>& ops) {
+        parse_factor(ops);
+        while (true) {
+            skip_spaces();
+            if (consume('*')) {
+                parse_factor(ops);
+                ops.push_back({DerivedOp::Kind::Mul});
+            } else if (consume('/')) {
+                parse_factor(ops);
+                ops.push_back({DerivedOp::Kind::Div});
+            } else {
+                break;
+            }
+        }
+    }
+
+    void parse_factor(std::vector<DerivedOp>& ops) {
+        skip_spaces();
+        if (consume('-')) {
+            parse_factor(ops);
+            ops.push_back({DerivedOp::Kind::Negate});
+            return;
+        }
+        if (consume('(')) {
+            parse_expr(ops);
+            expect(')');
+            return;
+        }
+        if (pos_ < expression_.size() &&
+            (std::isdigit(expression_[pos_]) || expression_[pos_] == '.')) {
+            size_t consumed = 0;
+            double value = std::stod(std::string(expression_.substr(pos_)), &consumed);
+            pos_ += consumed;
+            ops.push_back({DerivedOp::Kind::PushConst, value});
+            return;
+        }
+
+        auto ident = parse_identifier();
+        skip_spaces();
+        if (ident == "delta" && consume('(')) {
+            skip_spaces();
+            auto counter = parse_identifier();
+            expect(')');
+            ops.push_back({DerivedOp::Kind::PushDelta, 0.0, counter_slot(counter)});
+        } else if (ident == "dt" && consume('(')) {
+            expect(')');
+            ops.push_back({DerivedOp::Kind::PushDt});
+        } else {
+            ops.push_back({DerivedOp::Kind::PushValue, 0.0, counter_slot(ident)});
+        }
+    }
+
+    std::string parse_identifier() {
+        skip_spaces();
+        size_t start = pos_;
+        while (pos_ < expression_.size() &&
+               (std::isalnum(expression_[pos_]) || expression_[pos_] == '_')) {
+            pos_++;
+        }
+        if (pos_ == start) {
+            fail("expected identifier");
+        }
+        return std::string(expression_.substr(start, pos_ - start));
+    }
+
+    size_t counter_slot(const std::string& name) const {
+        for (size_t i = 0; i < counters_.size(); i++) {
+            if (counters_[i] == name) {
+                return i;
+            }
+        }
+        if (known_ != nullptr &&
+            std::find(known_->begin(), known_->end(), name) == known_->end()) {
+            throw std::runtime_error("Derived metric references counter not in any started group: " +
+                                     name);
+        }
+        return DERIVED_ABSENT_SLOT;
+    }
+
+    void skip_spaces() {
+        while (pos_ < expression_.size() && expression_[pos_] == ' ') {
+            pos_++;
+        }
+    }
+
+    bool consume(char c) {
+        if (pos_ < expression_.size() && expression_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        skip_spaces();
+        if (!consume(c)) {
+            fail(std::string("expected '") + c + "'");
+        }
+    }
+
+    void fail(const std::string& reason) const {
+        throw std::runtime_error("Invalid derived metric expression (" + reason +
+                                 "): " + std::string(expression_));
+    }
+
+    std::string_view expression_;
+    const std::vector<std::string>& counters_;
+    const std::vector<std::string>* known_;
+    size_t pos_ = 0;
+};
+
+// Run one compiled plan against the current and previous sample snapshots
+static double evaluate_derived(const std::vector<DerivedOp>& ops,
+                               const std::vector<double>& current,
+                               const std::vector<double>& previous, double dt) {
+    std::vector<double> stack;
+    stack.reserve(ops.size());
+
+    for (const auto& op : ops) {
+        switch (op.kind) {
+        case DerivedOp::Kind::PushConst:
+            stack.push_back(op.constant);
+            break;
+        case DerivedOp::Kind::PushValue:
+            stack.push_back(op.slot == DERIVED_ABSENT_SLOT
+                                ? std::numeric_limits<double>::quiet_NaN()
+                                : current[op.slot]);
+            break;
+        case DerivedOp::Kind::PushDelta:
+            stack.push_back(op.slot == DERIVED_ABSENT_SLOT
+                                ? std::numeric_limits<double>::quiet_NaN()
+                                : current[op.slot] - previous[op.slot]);
+            break;
+        case DerivedOp::Kind::PushDt:
+            stack.push_back(dt);
+            break;
+        case DerivedOp::Kind::Negate:
+            stack.back() = -stack.back();
+            break;
+        default: {
+            double rhs = stack.back();
+            stack.pop_back();
+            double& lhs = stack.back();
+            if (op.kind == DerivedOp::Kind::Add) {
+                lhs += rhs;
+            } else if (op.kind == DerivedOp::Kind::Sub) {
+                lhs -= rhs;
+            } else if (op.kind == DerivedOp::Kind::Mul) {
+                lhs *= rhs;
+            } else {
+                lhs = rhs != 0.0 ? lhs / rhs : 0.0;
+            }
+            break;
+        }
+        }
+    }
+
+    return stack.back();
+}
+
+void DeviceSampler::set_derived_metrics(const std::vector<std::string>& definitions) {
+    derived_definitions_ = definitions;
+    has_previous_ = false;
+    compile_derived(true);
+}
+
+void DeviceSampler::compile_derived(bool strict) {
+    // In strict mode (registration, restarts) counters unknown to every
+    // started group are compile errors, so bad definitions fail fast at
+    // setup. Recompiles triggered from the sampling path are lenient: the
+    // definitions were validated when registered, and counters owned by an
+    // inactive multiplex group must evaluate as NaN rather than throw from
+    // an ordinary sample call.
+    std::vector<std::string> known;
+    if (strict) {
+        known = active_counters_;
+        for (const auto& group : multiplex_groups_) {
+            known.insert(known.end(), group.begin(), group.end());
+        }
+    }
+
+    std::vector<DerivedMetric> plan;
+    plan.reserve(derived_definitions_.size());
+
+    for (const auto& definition : derived_definitions_) {
+        auto split = definition.find('=');
+        if (split == std::string::npos) {
+            throw std::runtime_error("Derived metric definition missing '=': " + definition);
+        }
+
+        DerivedMetric metric;
+        metric.name = definition.substr(0, split);
+        while (!metric.name.empty() && metric.name.back() == ' ') {
+            metric.name.pop_back();
+        }
+
+        auto compiler = DerivedExpressionCompiler(std::string_view(definition).substr(split + 1),
+                                                  active_counters_, strict ? &known : nullptr);
+        metric.ops = compiler.compile();
+        plan.push_back(std::move(metric));
+    }
+
+    derived_plan_ = std::move(plan);
+    derived_profile_ = profile_.handle;
+}
+
+const std::vector<double>& DeviceSampler::sample_derived() {
+    sample();
+
+    // Recompile when the active profile changed since registration, e.g.
+    // after a multiplex rotation or a plain start() with other counters
+    if (derived_profile_ != profile_.handle) {
+        compile_derived(false);
+        has_previous_ = false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (!has_previous_) {
+        derived_output_.assign(derived_plan_.size(), 0.0);
+    } else {
+        double dt = std::chrono::duration<double>(now - previous_time_).count();
+        derived_output_.resize(derived_plan_.size());
+        for (size_t i = 0; i < derived_plan_.size(); i++) {
+            derived_output_[i] = evaluate_derived(derived_plan_[i].ops, output_, previous_output_, dt);
+        }
+    }
+
+    previous_output_ = output_;
+    previous_time_ = now;
+    has_previous_ = true;
+
+    return derived_output_;
+}
+
+const std::vector<double>& DeviceSampler::sample() {
+    // With the background thread running, sampling is a wait-free snapshot
+    // read: subtract the cumulative totals seen at the previous call so the
+    // result covers exactly the activity since then, whatever the caller's
+    // cadence. No SDK calls happen on this thread.
+    if (periodic_thread_.joinable()) {
+        read_snapshot(periodic_snapshot_);
+        for (size_t i = 0; i < output_.size(); i++) {
+            output_[i] = periodic_snapshot_[i] - periodic_last_read_[i];
+        }
+        periodic_last_read_ = periodic_snapshot_;
+        return output_;
+    }
+
+    size_t size = records_.size();
+    rocprofiler_sample_device_counting_service(ctx_, {}, ROCPROFILER_COUNTER_FLAG_NONE,
+                                               records_.data(), &size);
+
+    auto& slots = profile_slots_[profile_.handle];
+    if (slots.size() != records_.size()) {
+        build_slot_table(slots);
+    }
+
     // Aggregate counter records: sums all records from each counter in an
-    // attempt to return a value that represents total activity.
-    rocprofiler_counter_id_t counter_id = {.handle = 0};
-    for (const auto& record : records_) {
-        rocprofiler_query_record_counter_id(record.id, &counter_id);
-        aggregate[counter_id.handle] += record.counter_value;
+    // attempt to return a value that represents total activity. With the
+    // precomputed slot table this is a plain indexed sum; the skip branch
+    // never fires in practice and predicts perfectly.
+    std::fill(output_.begin(), output_.end(), 0.0);
+    for (size_t i = 0; i < records_.size(); i++) {
+        if (slots[i] == SKIP_SLOT) {
+            continue;
+        }
+        output_[slots[i]] += records_[i].counter_value;
     }
 
-    const auto counter_ids = profile_counter_ids_[profile_.handle];
-    for (const auto& counter_id : counter_ids) {
-        result.push_back(aggregate[counter_id.handle]);
+    // Publish cumulative totals for shared-memory readers; the background
+    // thread does the same from its own loop when periodic mode is active
+    if (auto* segment = shm_segment_.load(std::memory_order_acquire)) {
+        for (size_t i = 0; i < output_.size() && i < shm_totals_.size(); i++) {
+            shm_totals_[i] += output_[i];
+        }
+        segment->publish(shm_device_, shm_totals_);
     }
 
-    return result;
+    if (!multiplex_groups_.empty()) {
+        // Save this group's values before a rotation resizes the output
+        // buffer for the next group, and return the saved copy so the
+        // caller's view stays valid across the switch
+        const size_t group = multiplex_current_;
+        multiplex_outputs_[group] = output_;
+
+        if (++multiplex_count_ >= multiplex_interval_) {
+            multiplex_count_ = 0;
+            multiplex_current_ = (multiplex_current_ + 1) % multiplex_groups_.size();
+            ROCPROFILER_CALL(rocprofiler_stop_context(ctx_), "stop context");
+            activate(multiplex_groups_[multiplex_current_]);
+        }
+
+        return multiplex_outputs_[group];
+    }
+
+    return output_;
 }
 
 } // namespace omnistat
@@ -197,8 +830,36 @@ int tool_init(rocprofiler_client_finalize_t fini_func, void*) {
         return -1;
     }
 
-    for (auto agent : agents) {
-        omnistat::samplers.push_back(std::make_shared<omnistat::DeviceSampler>(agent.id));
+    // Construct one sampler per agent in parallel; construction is
+    // independent per agent, and startup latency matters when the collector
+    // is launched from every job prolog on dense nodes
+    omnistat::samplers.resize(agents.size());
+    std::vector<std::exception_ptr> errors(agents.size());
+    std::vector<std::thread> workers;
+    workers.reserve(agents.size());
+
+    for (size_t i = 0; i < agents.size(); i++) {
+        workers.emplace_back([i, &agents, &errors]() {
+            try {
+                omnistat::samplers[i] = std::make_shared<omnistat::DeviceSampler>(agents[i].id);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (const auto& error : errors) {
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << "\n";
+            }
+            return -1;
+        }
     }
 
     return 0;
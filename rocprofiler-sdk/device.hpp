@@ -26,14 +26,52 @@
 
 #include <rocprofiler-sdk/rocprofiler.h>
 
+#include "shm_metrics.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 namespace omnistat {
 
+// One step of a compiled derived-metric evaluation plan. Expressions are
+// compiled once at registration into a flat postfix program evaluated with a
+// small value stack, so the per-sample cost is a few arithmetic ops.
+struct DerivedOp {
+    enum class Kind {
+        PushConst, // push constant
+        PushValue, // push current value of counter at slot
+        PushDelta, // push change of counter at slot since the previous sample
+        PushDt,    // push seconds elapsed since the previous sample
+        Negate,
+        Add,
+        Sub,
+        Mul,
+        Div, // division by zero yields 0, the monitoring-friendly choice
+    };
+
+    Kind kind;
+    double constant = 0.0;
+    size_t slot = 0;
+};
+
+// Slot sentinel for counters absent from the active profile (e.g. owned by
+// another multiplex group); PushValue and PushDelta referencing it evaluate
+// as NaN instead of failing mid-sampling
+constexpr size_t DERIVED_ABSENT_SLOT = SIZE_MAX;
+
+// A named derived metric and its evaluation plan
+struct DerivedMetric {
+    std::string name;
+    std::vector<DerivedOp> ops;
+};
+
 class DeviceSampler {
   public:
     DeviceSampler(rocprofiler_agent_id_t agent);
@@ -41,7 +79,78 @@ class DeviceSampler {
     void start(const std::vector<std::string>& counters);
     void stop();
 
-    std::vector<double> sample();
+    // Start counter collection on a free-running background thread that
+    // samples every interval_ms milliseconds, decoupling counter fidelity
+    // from the caller's scheduling: a late or stalled scrape loop no longer
+    // stretches the sampling window or loses activity. While the thread
+    // runs, sample() becomes a wait-free read of the latest published
+    // snapshot, returning the counts accumulated since the previous call.
+    // stop() joins the thread.
+    void start_periodic(const std::vector<std::string>& counters, uint64_t interval_ms);
+
+    // Start in multiplexing mode: hardware limits prevent collecting every
+    // counter in one profile, so rotate between the given counter groups,
+    // switching after samples_per_group calls to sample(). All profiles are
+    // created up front and rotation reuses them, so switching costs a
+    // context stop/start instead of a full profile setup.
+    void start_multiplexed(const std::vector<std::vector<std::string>>& counter_groups,
+                           uint64_t samples_per_group = 1);
+
+    // Most recent values for each multiplexed group, indexed like the
+    // counter_groups passed to start_multiplexed(). Groups not yet visited
+    // in the rotation are empty. Values are raw sums from each group's last
+    // active window; rate normalization is left to the consumer.
+    const std::vector<std::vector<double>>& sampled_groups() const { return multiplex_outputs_; }
+
+    // Index of the group the next sample() call will read
+    size_t current_group() const { return multiplex_current_; }
+
+    // Sample raw per-instance values (per SE/CU/... as reported by the SDK)
+    // instead of summing them, laid out counter-major, instance-minor in a
+    // persistent flat buffer. Same buffer-reuse semantics as sample(); the
+    // Python binding exposes it as a zero-copy numpy view.
+    const std::vector<double>& sample_detailed();
+
+    // Number of dimension instances for each counter of the active profile,
+    // in the order the counters were requested. Positions of each counter's
+    // instances in the detailed buffer are the prefix sums of these counts.
+    const std::vector<uint64_t>& instance_counts() const {
+        return profile_instance_counts_.at(profile_.handle);
+    }
+
+    // Register derived metrics as "name = expression" definitions, where
+    // expressions combine counter names of the active profile, numeric
+    // literals, + - * / and parentheses, plus delta(COUNTER) for the change
+    // since the previous sample and dt() for elapsed seconds. For example:
+    //   "valu_util = 100 * delta(SQ_ACTIVE_INST_VALU) / delta(GRBM_GUI_ACTIVE)"
+    // Definitions are compiled immediately, validated against every started
+    // counter group, and recompiled automatically when the active profile
+    // changes (e.g. multiplex rotation). A metric referencing counters of an
+    // inactive multiplex group evaluates as NaN until that group rotates in.
+    void set_derived_metrics(const std::vector<std::string>& definitions);
+
+    // Sample and evaluate the registered derived metrics, in registration
+    // order. The first call after (re)registration has no baseline snapshot
+    // and returns zeros. Same buffer-reuse semantics as sample().
+    const std::vector<double>& sample_derived();
+
+    // Counter names of the active profile, in requested order
+    const std::vector<std::string>& active_counters() const { return active_counters_; }
+
+    // Publish this sampler's values into slots of a shared metrics segment
+    // after every sample, whether taken directly or by the background
+    // thread. Published values are cumulative totals since attachment so a
+    // reader at any cadence can difference them without missing activity.
+    void attach_shm(ShmMetricsSegment* segment, size_t device);
+
+    // Sample and aggregate counter values into the persistent output buffer,
+    // returning a reference to it. The buffer is overwritten by the next
+    // call and resized by start(); the Python binding exposes it as a
+    // zero-copy numpy view tied to the sampler's lifetime. After
+    // start_periodic() this never touches the SDK: it reads the background
+    // thread's latest snapshot and returns the accumulation since the
+    // previous read.
+    const std::vector<double>& sample();
 
   private:
     rocprofiler_agent_id_t agent_ = {};
@@ -58,17 +167,113 @@ class DeviceSampler {
     std::unordered_map<uint64_t, uint64_t> profile_sizes_;
     std::unordered_map<uint64_t, std::vector<rocprofiler_counter_id_t>> profile_counter_ids_;
 
+    // Dense record index -> output slot table per profile. The record →
+    // counter layout is fixed once a profile is created, so the table is
+    // built from the first sample of each profile and turns steady-state
+    // aggregation into an indexed sum with no per-record SDK queries.
+    // Records not matching a requested counter get SKIP_SLOT.
+    static constexpr size_t SKIP_SLOT = SIZE_MAX;
+    std::unordered_map<uint64_t, std::vector<size_t>> profile_slots_;
+
+    // Per-profile dimension metadata and record index -> detailed buffer
+    // position tables for sample_detailed(). Instance counts are recorded at
+    // profile creation; position tables are built from the first detailed
+    // sample, like profile_slots_.
+    std::unordered_map<uint64_t, std::vector<uint64_t>> profile_instance_counts_;
+    std::unordered_map<uint64_t, std::vector<size_t>> profile_detailed_slots_;
+
     // Buffer records from last sample; its size changes every time a new
     // profile is started
     std::vector<rocprofiler_record_counter_t> records_;
 
+    // Aggregated per-counter values from the last sample, in the order the
+    // counters were requested; reused across samples to avoid per-call
+    // allocation and conversion
+    std::vector<double> output_;
+
+    // Per-instance values from the last detailed sample, counter-major and
+    // instance-minor; reused across samples like output_
+    std::vector<double> detailed_output_;
+
+    // Derived metrics: definition strings, the plan compiled against the
+    // counter layout of the profile identified by derived_profile_, and the
+    // previous-sample snapshot the delta/dt operands read from
+    std::vector<std::string> derived_definitions_;
+    std::vector<DerivedMetric> derived_plan_;
+    uint64_t derived_profile_ = 0;
+    std::vector<double> derived_output_;
+    std::vector<double> previous_output_;
+    std::chrono::steady_clock::time_point previous_time_;
+    bool has_previous_ = false;
+
+    // Counter names of the active profile, in requested order; used to
+    // resolve identifiers when compiling derived metrics
+    std::vector<std::string> active_counters_;
+
+    // Multiplexing state: the rotation schedule and the last values sampled
+    // for each group. An empty group list means multiplexing is off.
+    std::vector<std::vector<std::string>> multiplex_groups_;
+    std::vector<std::vector<double>> multiplex_outputs_;
+    uint64_t multiplex_interval_ = 1;
+    uint64_t multiplex_count_ = 0;
+    size_t multiplex_current_ = 0;
+
+    // Background sampling state. The thread samples every
+    // periodic_interval_ms_ and publishes cumulative per-counter totals
+    // through a seqlock-protected double buffer: an odd sequence number
+    // marks a slot mid-write, and the writer alternates slots so a reader
+    // copying the latest slot has a full interval before the writer returns
+    // to it — retries are possible in theory, never observed in practice.
+    std::thread periodic_thread_;
+    std::atomic<bool> periodic_stop_{false};
+    uint64_t periodic_interval_ms_ = 0;
+    std::vector<double> periodic_totals_; // writer-private cumulative sums
+    std::vector<double> snapshot_values_[2];
+    std::atomic<uint64_t> snapshot_seq_[2] = {};
+    std::atomic<size_t> snapshot_latest_{0};
+    std::vector<double> periodic_snapshot_;  // reader-side copy scratch
+    std::vector<double> periodic_last_read_; // totals at the previous sample()
+
+    // Shared metrics segment attachment; atomic because attach_shm() may
+    // run while the background thread is already sampling. shm_totals_
+    // tracks cumulative sums for the direct path (the background thread
+    // publishes periodic_totals_, which are already cumulative).
+    std::atomic<ShmMetricsSegment*> shm_segment_{nullptr};
+    size_t shm_device_ = 0;
+    std::vector<double> shm_totals_;
+
+    // Whether the device counting service has been configured on ctx_; done
+    // lazily on first activation so collectors monitoring a subset of GPUs
+    // never pay the per-agent service setup for the rest
+    bool service_configured_ = false;
+
     void set_profile(rocprofiler_context_id_t ctx,
                      rocprofiler_agent_set_profile_callback_t cb) const;
-    std::unordered_map<std::string, rocprofiler_counter_id_t> get_supported_counters() const;
+    void configure_service();
+    void periodic_loop();
+    void read_snapshot(std::vector<double>& out) const;
+    void build_slot_table(std::vector<size_t>& slots) const;
+    void build_detailed_slot_table(std::vector<size_t>& slots) const;
+    void activate(const std::vector<std::string>& counters);
+    // Compile the registered definitions against the active profile. Strict
+    // compiles reject counters unknown to every started group; lenient ones
+    // (from the sampling path) map them to DERIVED_ABSENT_SLOT instead.
+    void compile_derived(bool strict);
 };
 
 void initialize();
 
 const std::vector<std::shared_ptr<DeviceSampler>>& get_samplers();
 
+// Sample every device concurrently from C++ worker threads, returning one
+// result vector per sampler in registry order. Bound with the GIL released
+// so a scrape costs the slowest single device instead of the sum of all.
+std::vector<std::vector<double>> sample_all();
+
+// Create a shared-memory metrics segment at path with one slot per active
+// counter of every sampler, and attach the samplers so each subsequent
+// sample publishes into it. Call after the samplers are started — the slot
+// layout is built from their active counters and is fixed afterwards.
+void enable_shm_metrics(const std::string& path);
+
 } // namespace omnistat
@@ -0,0 +1,787 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2025 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+// Node-level trace forwarder for many-rank nodes. Each rank tracer normally
+// opens its own connection to the endpoint, so an 8-rank node produces 8
+// concurrent POST streams carrying largely duplicate kernel-name data. The
+// forwarder collapses that: ranks point OMNISTAT_TRACE_SOCKET at its Unix
+// domain socket, and it absorbs their POSTs (acknowledging immediately so
+// ranks never wait on the upstream), merges per-rank kernel dictionaries
+// into one node-level dictionary — rewriting binary ID records to reference
+// it — and forwards a single combined stream to the endpoint over one
+// pooled connection.
+//
+// Usage: omnistat_trace_forwarder [socket_path] [endpoint_port]
+//
+// Defaults are read from OMNISTAT_TRACE_SOCKET and
+// OMNISTAT_TRACE_ENDPOINT_PORT, so the forwarder and the rank tracers can
+// share the same job-script environment.
+
+#include "trace_format.hpp"
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(HAS_STD_FORMAT)
+#include <format>
+namespace fmt = std;
+#else
+#include <fmt/core.h>
+#endif
+
+namespace {
+
+// Bound on payloads queued for the upstream thread; the oldest payload is
+// dropped on overflow, mirroring the tracer's send queue policy
+constexpr size_t FORWARD_QUEUE_DEPTH = 64;
+
+// Retries for failed upstream POSTs, with linear backoff; the ranks have
+// already been acknowledged, so this is the last line before data loss
+constexpr int UPSTREAM_RETRIES = 2;
+constexpr int UPSTREAM_BACKOFF_MS = 250;
+
+// Largest request body accepted from a rank; anything bigger than a few
+// flush payloads indicates a confused client
+constexpr size_t MAX_BODY_BYTES = 64 * 1024 * 1024;
+
+std::atomic<bool> stop_requested{false};
+
+void signal_handler(int) { stop_requested.store(true); }
+
+uint64_t parse_env_uint(const char* env_var_name, uint64_t default_value) {
+    const char* env_value = std::getenv(env_var_name);
+    if (env_value == nullptr) {
+        return default_value;
+    }
+    try {
+        uint64_t value = std::stoull(env_value);
+        if (value > 0) {
+            return value;
+        }
+    } catch (const std::exception&) {
+    }
+    std::cerr << "Invalid " << env_var_name << " value (" << env_value << "), using default "
+              << default_value << std::endl;
+    return default_value;
+}
+
+// One request absorbed from a rank, already transformed and ready to POST
+struct ForwardPayload {
+    std::string path;
+    std::string content_type;
+    std::string content_encoding;
+    std::string body;
+};
+
+// Node-level kernel dictionary. Rank tracers in dictionary mode each sync
+// (rank-local id, name) pairs scoped by their client id; with many ranks the
+// same demangled names arrive once per rank. The merger assigns one global
+// id per unique name, forwards each name upstream exactly once (as client 0,
+// the forwarder's identity), and rewrites binary ID records so all ranks'
+// dispatches reference the shared dictionary.
+class DictionaryMerger {
+  public:
+    // Fold one rank's dictionary sync payload into the node dictionary.
+    // Returns the payload to forward upstream — only the names the endpoint
+    // has not seen yet — or an empty string when every name is known.
+    std::string merge(std::string_view body);
+
+    // Rewrite a binary kernel-ID payload in place to reference the node
+    // dictionary: the header client becomes 0 and each record's kernel id is
+    // mapped from (client, rank-local id) to its global id. Payloads that
+    // don't match the expected layout are left untouched.
+    void remap(std::string& body);
+
+    // Same rewrite for JSON payloads carrying dictionary ids: raw records,
+    // interval aggregates, and annotation window roll-ups all encode entries
+    // as [gpu_id, kernel_id, ...] arrays under a client-scoped object.
+    // Payloads with embedded names (dictionary mode off) or an unexpected
+    // shape are left untouched.
+    void remap_json(std::string& body);
+
+    uint64_t names_deduplicated() const { return names_deduplicated_.load(); }
+
+  private:
+    // Global id for a (client, rank-local id) pair, lazily allocating one
+    // for ids that race ahead of their dictionary sync. Caller holds mutex_.
+    uint64_t global_id(uint32_t client, uint64_t kernel_id);
+
+    std::mutex mutex_;
+    // Names are keyed in their JSON-escaped form: the tracer-side escaper is
+    // deterministic, so the escaped span identifies the name without a
+    // decode/re-encode round trip
+    std::unordered_map<std::string, uint64_t> ids_by_name_;
+    std::map<std::pair<uint32_t, uint64_t>, uint64_t> global_ids_;
+    std::unordered_set<uint64_t> synced_;
+    uint64_t next_id_ = 1;
+    std::atomic<uint64_t> names_deduplicated_{0};
+};
+
+// Parse the fixed shape of a dictionary sync payload,
+// {"client":N,"kernels":[[id,"name"],...]}, capturing names as their raw
+// escaped spans. Returns false on anything malformed.
+bool parse_dict_payload(std::string_view body, uint32_t& client,
+                        std::vector<std::pair<uint64_t, std::string_view>>& entries) {
+    auto parse_uint = [&](size_t& pos, uint64_t& value) {
+        if (pos >= body.size() || body[pos] < '0' || body[pos] > '9') {
+            return false;
+        }
+        value = 0;
+        while (pos < body.size() && body[pos] >= '0' && body[pos] <= '9') {
+            value = value * 10 + static_cast<uint64_t>(body[pos] - '0');
+            ++pos;
+        }
+        return true;
+    };
+
+    size_t pos = body.find("\"client\":");
+    if (pos == std::string_view::npos) {
+        return false;
+    }
+    pos += 9;
+    uint64_t client_value = 0;
+    if (!parse_uint(pos, client_value) || client_value > UINT32_MAX) {
+        return false;
+    }
+    client = static_cast<uint32_t>(client_value);
+
+    pos = body.find("\"kernels\":[", pos);
+    if (pos == std::string_view::npos) {
+        return false;
+    }
+    pos += 11;
+
+    while (true) {
+        while (pos < body.size() && (body[pos] == ',' || body[pos] == ' ')) {
+            ++pos;
+        }
+        if (pos < body.size() && body[pos] == ']') {
+            return true;
+        }
+        if (pos >= body.size() || body[pos] != '[') {
+            return false;
+        }
+        ++pos;
+
+        uint64_t kernel_id = 0;
+        if (!parse_uint(pos, kernel_id)) {
+            return false;
+        }
+        if (pos >= body.size() || body[pos] != ',') {
+            return false;
+        }
+        ++pos;
+        if (pos >= body.size() || body[pos] != '"') {
+            return false;
+        }
+        ++pos;
+
+        // Scan for the closing quote, honoring backslash escapes
+        size_t name_start = pos;
+        while (pos < body.size() && body[pos] != '"') {
+            pos += (body[pos] == '\\') ? 2 : 1;
+        }
+        if (pos >= body.size()) {
+            return false;
+        }
+        entries.emplace_back(kernel_id, body.substr(name_start, pos - name_start));
+        ++pos;
+
+        if (pos >= body.size() || body[pos] != ']') {
+            return false;
+        }
+        ++pos;
+    }
+}
+
+uint64_t DictionaryMerger::global_id(uint32_t client, uint64_t kernel_id) {
+    auto [it, inserted] = global_ids_.try_emplace({client, kernel_id}, next_id_);
+    if (inserted) {
+        ++next_id_;
+    }
+    return it->second;
+}
+
+std::string DictionaryMerger::merge(std::string_view body) {
+    std::vector<std::pair<uint64_t, std::string_view>> entries;
+    uint32_t client = 0;
+    if (!parse_dict_payload(body, client, entries)) {
+        // Unexpected shape: pass it through untouched rather than lose it
+        return std::string{body};
+    }
+
+    std::string forward;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (const auto& [kernel_id, name] : entries) {
+        std::string key{name};
+
+        // Records can outrun their dictionary sync and force an unnamed id;
+        // remember it so those already-forwarded records get named below
+        auto forced = global_ids_.find({client, kernel_id});
+        uint64_t forced_id = (forced != global_ids_.end()) ? forced->second : 0;
+
+        uint64_t id;
+        auto name_it = ids_by_name_.find(key);
+        if (name_it != ids_by_name_.end()) {
+            // Another rank already contributed this name; only the mapping
+            // is new
+            id = name_it->second;
+            names_deduplicated_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            id = global_id(client, kernel_id);
+            ids_by_name_.emplace(std::move(key), id);
+        }
+        global_ids_[{client, kernel_id}] = id;
+
+        // Forward each global id's name exactly once
+        for (uint64_t announce : {forced_id, id}) {
+            if (announce == 0 || !synced_.insert(announce).second) {
+                continue;
+            }
+            if (forward.empty()) {
+                forward = "{\"client\":0,\"kernels\":[";
+            }
+            fmt::format_to(std::back_inserter(forward), "[{},\"", announce);
+            forward.append(name);
+            forward.append("\"],");
+        }
+    }
+
+    if (!forward.empty()) {
+        forward.back() = ']';
+        forward.push_back('}');
+    }
+    return forward;
+}
+
+void DictionaryMerger::remap(std::string& body) {
+    using omnistat::BINARY_FLAG_KERNEL_IDS;
+    using omnistat::BINARY_FORMAT_VERSION;
+    using omnistat::BINARY_HEADER_SIZE;
+    using omnistat::BINARY_ID_RECORD_SIZE;
+
+    if (body.size() < BINARY_HEADER_SIZE || body.compare(0, 4, "OMTR") != 0 ||
+        static_cast<uint8_t>(body[4]) != BINARY_FORMAT_VERSION ||
+        (static_cast<uint8_t>(body[5]) & BINARY_FLAG_KERNEL_IDS) == 0) {
+        return;
+    }
+
+    uint32_t num_records = 0;
+    uint32_t client = 0;
+    std::memcpy(&num_records, body.data() + 8, sizeof(num_records));
+    std::memcpy(&client, body.data() + 12, sizeof(client));
+    if (body.size() != BINARY_HEADER_SIZE + num_records * BINARY_ID_RECORD_SIZE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (uint32_t i = 0; i < num_records; ++i) {
+        size_t offset = BINARY_HEADER_SIZE + i * BINARY_ID_RECORD_SIZE + 8;
+        uint64_t kernel_id = 0;
+        std::memcpy(&kernel_id, body.data() + offset, sizeof(kernel_id));
+        uint64_t mapped = global_id(client, kernel_id);
+        std::memcpy(body.data() + offset, &mapped, sizeof(mapped));
+    }
+
+    // All ranks' remapped records share the forwarder's dictionary scope
+    uint32_t forwarder_client = 0;
+    std::memcpy(body.data() + 12, &forwarder_client, sizeof(forwarder_client));
+}
+
+void DictionaryMerger::remap_json(std::string& body) {
+    auto parse_uint = [&body](size_t& pos, uint64_t& value) {
+        if (pos >= body.size() || body[pos] < '0' || body[pos] > '9') {
+            return false;
+        }
+        value = 0;
+        while (pos < body.size() && body[pos] >= '0' && body[pos] <= '9') {
+            value = value * 10 + static_cast<uint64_t>(body[pos] - '0');
+            ++pos;
+        }
+        return true;
+    };
+
+    size_t client_pos = body.find("\"client\":");
+    if (client_pos == std::string::npos) {
+        return;
+    }
+    size_t client_start = client_pos + 9;
+    size_t pos = client_start;
+    uint64_t client_value = 0;
+    if (!parse_uint(pos, client_value) || client_value > UINT32_MAX) {
+        return;
+    }
+    uint32_t client = static_cast<uint32_t>(client_value);
+    size_t client_end = pos;
+
+    // Locate the entry array for the payload kind; health payloads and other
+    // client-scoped objects without one pass through untouched
+    size_t entries_pos = std::string::npos;
+    for (std::string_view key : {"\"records\":[", "\"aggregate\":[", "\"kernels\":["}) {
+        size_t key_pos = body.find(key, client_end);
+        if (key_pos != std::string::npos) {
+            entries_pos = key_pos + key.size();
+            break;
+        }
+    }
+    if (entries_pos == std::string::npos) {
+        return;
+    }
+
+    // Remapped ids change width, so rebuild into a scratch copy and swap it
+    // in only once the whole payload has parsed
+    std::string out;
+    out.reserve(body.size());
+    out.append(body, 0, client_start);
+    out.push_back('0');
+    out.append(body, client_end, entries_pos - client_end);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t copied = entries_pos;
+    pos = entries_pos;
+    while (true) {
+        while (pos < body.size() && (body[pos] == ',' || body[pos] == ' ')) {
+            ++pos;
+        }
+        if (pos < body.size() && body[pos] == ']') {
+            break;
+        }
+        if (pos >= body.size() || body[pos] != '[') {
+            return;
+        }
+        ++pos;
+
+        uint64_t gpu_id = 0;
+        if (!parse_uint(pos, gpu_id)) {
+            return;
+        }
+        if (pos >= body.size() || body[pos] != ',') {
+            return;
+        }
+        ++pos;
+
+        // A quoted second field is an embedded kernel name: the stream does
+        // not use the dictionary and needs no rewriting
+        if (pos < body.size() && body[pos] == '"') {
+            return;
+        }
+        size_t id_start = pos;
+        uint64_t kernel_id = 0;
+        if (!parse_uint(pos, kernel_id)) {
+            return;
+        }
+        out.append(body, copied, id_start - copied);
+        fmt::format_to(std::back_inserter(out), "{}", global_id(client, kernel_id));
+        copied = pos;
+
+        // Skip the rest of the entry, honoring nested bucket arrays and
+        // escaped strings
+        int depth = 1;
+        while (pos < body.size() && depth > 0) {
+            char c = body[pos++];
+            if (c == '[') {
+                ++depth;
+            } else if (c == ']') {
+                --depth;
+            } else if (c == '"') {
+                while (pos < body.size() && body[pos] != '"') {
+                    pos += (body[pos] == '\\') ? 2 : 1;
+                }
+                ++pos;
+            }
+        }
+        if (depth != 0) {
+            return;
+        }
+    }
+
+    out.append(body, copied, body.size() - copied);
+    body = std::move(out);
+}
+
+// Bounded queue decoupling rank acknowledgements from upstream POSTs
+class ForwardQueue {
+  public:
+    void push(ForwardPayload&& payload) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.size() >= FORWARD_QUEUE_DEPTH) {
+                queue_.pop_front();
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+            queue_.push_back(std::move(payload));
+        }
+        cv_.notify_one();
+    }
+
+    // Blocks until a payload is available or the queue is shut down and
+    // drained; returns false in the latter case
+    bool pop(ForwardPayload& payload) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !queue_.empty() || shutdown_; });
+        if (queue_.empty()) {
+            return false;
+        }
+        payload = std::move(queue_.front());
+        queue_.pop_front();
+        return true;
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shutdown_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    uint64_t dropped() const { return dropped_.load(); }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<ForwardPayload> queue_;
+    bool shutdown_ = false;
+    std::atomic<uint64_t> dropped_{0};
+};
+
+struct ForwarderStats {
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> forwarded{0};
+    std::atomic<uint64_t> failed{0};
+};
+
+DictionaryMerger merger;
+ForwardQueue forward_queue;
+ForwarderStats stats;
+
+size_t discard_response(char*, size_t size, size_t nmemb, void*) { return size * nmemb; }
+
+// Drain the queue into the endpoint over one long-lived connection
+void upstream_loop(const std::string& base_url) {
+    CURL* curl = curl_easy_init();
+    if (curl == nullptr) {
+        std::cerr << "omnistat-forwarder: failed to initialize libcurl" << std::endl;
+        return;
+    }
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &discard_response);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    ForwardPayload payload;
+    while (forward_queue.pop(payload)) {
+        std::string url = base_url + payload.path;
+
+        struct curl_slist* headers = nullptr;
+        std::string content_type = "Content-Type: " + payload.content_type;
+        headers = curl_slist_append(headers, content_type.c_str());
+        if (!payload.content_encoding.empty()) {
+            std::string encoding = "Content-Encoding: " + payload.content_encoding;
+            headers = curl_slist_append(headers, encoding.c_str());
+        }
+
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(payload.body.size()));
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.body.data());
+
+        bool success = false;
+        for (int attempt = 0; attempt <= UPSTREAM_RETRIES && !success; ++attempt) {
+            if (attempt > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(UPSTREAM_BACKOFF_MS));
+            }
+            if (curl_easy_perform(curl) != CURLE_OK) {
+                continue;
+            }
+            long http_code = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+            if (http_code < 400) {
+                success = true;
+            } else if (http_code < 500) {
+                // Client-side rejection, retrying cannot help
+                break;
+            }
+        }
+
+        curl_slist_free_all(headers);
+
+        if (success) {
+            stats.forwarded.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            stats.failed.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "omnistat-forwarder: failed to post to " << url << std::endl;
+        }
+    }
+
+    curl_easy_cleanup(curl);
+}
+
+// Read exactly the HTTP request head (through the blank line), then the
+// Content-Length body. Returns false when the peer closes or sends anything
+// that doesn't parse as a POST.
+bool read_request(int fd, std::string& buffered, std::string& path, std::string& content_type,
+                  std::string& content_encoding, std::string& body) {
+    auto header_value = [](std::string_view head, std::string_view name) -> std::string {
+        size_t pos = 0;
+        while (pos < head.size()) {
+            size_t eol = head.find("\r\n", pos);
+            if (eol == std::string_view::npos) {
+                eol = head.size();
+            }
+            std::string_view line = head.substr(pos, eol - pos);
+            if (line.size() > name.size() + 1 && line[name.size()] == ':') {
+                bool match = true;
+                for (size_t i = 0; i < name.size(); ++i) {
+                    if (std::tolower(static_cast<unsigned char>(line[i])) != name[i]) {
+                        match = false;
+                        break;
+                    }
+                }
+                if (match) {
+                    size_t value = name.size() + 1;
+                    while (value < line.size() && line[value] == ' ') {
+                        ++value;
+                    }
+                    return std::string{line.substr(value)};
+                }
+            }
+            pos = eol + 2;
+        }
+        return {};
+    };
+
+    // Reads use a receive timeout so connections held open by idle ranks
+    // still notice shutdown requests
+    auto read_chunk = [fd](std::string& buffer) {
+        char chunk[65536];
+        while (true) {
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && !stop_requested.load()) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+            return true;
+        }
+    };
+
+    size_t head_end;
+    while ((head_end = buffered.find("\r\n\r\n")) == std::string::npos) {
+        if (buffered.size() > 64 * 1024 || !read_chunk(buffered)) {
+            return false;
+        }
+    }
+
+    std::string_view head{buffered.data(), head_end};
+    if (head.substr(0, 5) != "POST ") {
+        return false;
+    }
+    size_t path_end = head.find(' ', 5);
+    if (path_end == std::string_view::npos) {
+        return false;
+    }
+    path = std::string{head.substr(5, path_end - 5)};
+
+    content_type = header_value(head, "content-type");
+    content_encoding = header_value(head, "content-encoding");
+
+    size_t content_length = 0;
+    try {
+        content_length = std::stoull(header_value(head, "content-length"));
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (content_length > MAX_BODY_BYTES) {
+        return false;
+    }
+
+    buffered.erase(0, head_end + 4);
+    while (buffered.size() < content_length) {
+        if (!read_chunk(buffered)) {
+            return false;
+        }
+    }
+
+    body = buffered.substr(0, content_length);
+    buffered.erase(0, content_length);
+    return true;
+}
+
+// Serve one rank's connection: absorb POSTs, transform, enqueue, and
+// acknowledge immediately so the rank never waits on the upstream endpoint
+void handle_connection(int fd) {
+    constexpr const char* ack = "HTTP/1.1 204 No Content\r\ncontent-length: 0\r\n\r\n";
+    constexpr const char* nack =
+        "HTTP/1.1 400 Bad Request\r\ncontent-length: 0\r\nconnection: close\r\n\r\n";
+
+    std::string buffered;
+    ForwardPayload payload;
+    while (read_request(fd, buffered, payload.path, payload.content_type,
+                        payload.content_encoding, payload.body)) {
+        stats.received.fetch_add(1, std::memory_order_relaxed);
+
+        bool drop = false;
+        bool is_json = payload.content_type.rfind("application/json", 0) == 0;
+        bool uncompressed = payload.content_encoding.empty();
+
+        if (payload.path.size() >= 5 &&
+            payload.path.compare(payload.path.size() - 5, 5, "/dict") == 0 && is_json &&
+            uncompressed) {
+            payload.body = merger.merge(payload.body);
+            drop = payload.body.empty();
+        } else if (payload.content_type == omnistat::BINARY_CONTENT_TYPE && uncompressed) {
+            merger.remap(payload.body);
+        } else if (is_json && uncompressed) {
+            merger.remap_json(payload.body);
+        }
+
+        if (!drop) {
+            forward_queue.push(std::move(payload));
+            payload = ForwardPayload{};
+        }
+
+        if (write(fd, ack, strlen(ack)) < 0) {
+            break;
+        }
+    }
+
+    // Anything left unparsed means the peer sent garbage rather than closing
+    if (!buffered.empty()) {
+        ssize_t ignored = write(fd, nack, strlen(nack));
+        (void)ignored;
+    }
+    close(fd);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* socket_env = std::getenv("OMNISTAT_TRACE_SOCKET");
+    std::string socket_path = (argc > 1) ? argv[1] : (socket_env != nullptr ? socket_env : "");
+    if (socket_path.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [socket_path] [endpoint_port]\n"
+                  << "The socket path defaults to OMNISTAT_TRACE_SOCKET." << std::endl;
+        return 1;
+    }
+
+    uint64_t endpoint_port = (argc > 2)
+                                 ? std::strtoull(argv[2], nullptr, 10)
+                                 : parse_env_uint("OMNISTAT_TRACE_ENDPOINT_PORT", 8001);
+    std::string base_url = fmt::format("http://localhost:{}", endpoint_port);
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cerr << "omnistat-forwarder: failed to create socket" << std::endl;
+        return 1;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "omnistat-forwarder: socket path too long: " << socket_path << std::endl;
+        return 1;
+    }
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socket_path.c_str());
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd, 64) < 0) {
+        std::cerr << "omnistat-forwarder: failed to listen on " << socket_path << std::endl;
+        return 1;
+    }
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::thread upstream(upstream_loop, base_url);
+
+    std::cout << "omnistat-forwarder: listening on " << socket_path << ", forwarding to "
+              << base_url << std::endl;
+
+    // Accept with a timeout so shutdown signals are noticed promptly
+    timeval accept_timeout{.tv_sec = 0, .tv_usec = 200000};
+    setsockopt(listen_fd, SOL_SOCKET, SO_RCVTIMEO, &accept_timeout, sizeof(accept_timeout));
+
+    std::vector<std::thread> connections;
+    while (!stop_requested.load()) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        // Reads inherit a timeout so connection threads can notice shutdown
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &accept_timeout, sizeof(accept_timeout));
+        connections.emplace_back(handle_connection, fd);
+    }
+
+    close(listen_fd);
+    unlink(socket_path.c_str());
+
+    // Connections end when the ranks exit; the queue then drains fully so
+    // acknowledged payloads are not lost at shutdown
+    for (auto& connection : connections) {
+        connection.join();
+    }
+    forward_queue.shutdown();
+    upstream.join();
+    curl_global_cleanup();
+
+    std::cout << "omnistat-forwarder: " << stats.forwarded << "/" << stats.received
+              << " payloads forwarded (" << stats.failed << " failed, " << forward_queue.dropped()
+              << " dropped on overflow, " << merger.names_deduplicated()
+              << " duplicate kernel names merged)" << std::endl;
+
+    return stats.failed.load() == 0 ? 0 : 1;
+}
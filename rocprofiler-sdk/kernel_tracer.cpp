@@ -24,11 +24,18 @@
 
 #include "kernel_tracer.hpp"
 #include "common.hpp"
+#include "trace_format.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <chrono>
+#include <cerrno>
 #include <cxxabi.h>
+#include <fcntl.h>
 #include <iterator>
 #include <memory>
+#include <poll.h>
+#include <sys/stat.h>
 #include <thread>
 #include <unistd.h>
 
@@ -39,20 +46,85 @@ namespace fmt = std;
 #include <fmt/core.h>
 #endif
 
+#if defined(HAS_ZSTD)
+#include <zstd.h>
+#endif
+
 namespace omnistat {
 
-// Demangle kernel names
-static std::string demangle(const char* mangled_name) {
+// Demangle kernel names. Results are cached by mangled name since
+// abi::__cxa_demangle is malloc-heavy and CPU-expensive, and frameworks can
+// re-register identical symbols many times as code objects are loaded and
+// unloaded across application phases. Entries are kept for the lifetime of
+// the process, surviving code object unloads.
+const std::string& KernelTracer::demangle(const char* mangled_name) {
+    // Frameworks can register code objects from several threads at once
+    std::lock_guard<std::mutex> lock(demangle_mutex_);
+
+    auto it = demangle_cache_.find(mangled_name);
+    if (it != demangle_cache_.end()) {
+        return it->second;
+    }
+
     int status = -1;
     std::unique_ptr<char, void (*)(void*)> result(
         abi::__cxa_demangle(mangled_name, nullptr, nullptr, &status), std::free);
-    return (status == 0) ? result.get() : mangled_name;
+    std::string demangled = (status == 0) ? result.get() : mangled_name;
+
+    return demangle_cache_.emplace(mangled_name, std::move(demangled)).first->second;
+}
+
+void KernelNameMap::insert(uint64_t kernel_id, const std::string* name) {
+    if (kernel_id < DENSE_CAPACITY) {
+        dense_[kernel_id].store(name, std::memory_order_release);
+        return;
+    }
+
+    auto& shard = shards_[kernel_id % NUM_SHARDS];
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    shard.map[kernel_id] = name;
+}
+
+void KernelNameMap::erase(uint64_t kernel_id) {
+    if (kernel_id < DENSE_CAPACITY) {
+        dense_[kernel_id].store(nullptr, std::memory_order_release);
+        return;
+    }
+
+    auto& shard = shards_[kernel_id % NUM_SHARDS];
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    shard.map.erase(kernel_id);
+}
+
+const std::string* KernelNameMap::find(uint64_t kernel_id) const {
+    if (kernel_id < DENSE_CAPACITY) {
+        return dense_[kernel_id].load(std::memory_order_acquire);
+    }
+
+    const auto& shard = shards_[kernel_id % NUM_SHARDS];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.map.find(kernel_id);
+    return it != shard.map.end() ? it->second : nullptr;
 }
 
 static size_t write_callback(char* ptr, size_t size, size_t nmemb, void* userdata) {
     return size * nmemb;
 }
 
+// Parse the OMNISTAT_TRACE_FORMAT environment variable, defaulting to JSON
+static TraceFormat parse_trace_format() {
+    const char* env_value = std::getenv("OMNISTAT_TRACE_FORMAT");
+    if (env_value == nullptr || std::string_view(env_value) == "json") {
+        return TraceFormat::Json;
+    } else if (std::string_view(env_value) == "binary") {
+        return TraceFormat::Binary;
+    }
+
+    std::cerr << "Invalid OMNISTAT_TRACE_FORMAT value (" << env_value << "), using json"
+              << std::endl;
+    return TraceFormat::Json;
+}
+
 // Callback used to register kernels when loading code objects. Forces a flush
 // on every kernel unload; the expectation is that only happens at the end of
 // the application and it's only triggered once for the first kernel unload.
@@ -65,9 +137,11 @@ void code_object_callback(rocprofiler_callback_tracing_record_t record,
         if (record.phase == ROCPROFILER_CALLBACK_PHASE_UNLOAD) {
             // Never reached when using the tool with the ROCP_TOOL_LIBRARIES
             // environment variable, hence the need to flush on kernel unload.
-            auto flush_status = rocprofiler_flush_buffer(tracer->buffer);
-            if (flush_status != ROCPROFILER_STATUS_ERROR_BUFFER_BUSY)
-                ROCPROFILER_CALL(flush_status, "flush buffer");
+            for (auto buffer : tracer->buffers) {
+                auto flush_status = rocprofiler_flush_buffer(buffer);
+                if (flush_status != ROCPROFILER_STATUS_ERROR_BUFFER_BUSY)
+                    ROCPROFILER_CALL(flush_status, "flush buffer");
+            }
         }
     } else if (record.kind == ROCPROFILER_CALLBACK_TRACING_CODE_OBJECT &&
                record.operation == ROCPROFILER_CODE_OBJECT_DEVICE_KERNEL_SYMBOL_REGISTER) {
@@ -75,20 +149,37 @@ void code_object_callback(rocprofiler_callback_tracing_record_t record,
             static_cast<rocprofiler_callback_tracing_code_object_kernel_symbol_register_data_t*>(
                 record.payload);
         if (record.phase == ROCPROFILER_CALLBACK_PHASE_LOAD) {
-            tracer->kernels.emplace(data->kernel_id, demangle(data->kernel_name));
+            const auto& kernel_name = tracer->demangle(data->kernel_name);
+            if (tracer->dictionary_enabled) {
+                tracer->queue_dictionary_entry(data->kernel_id, kernel_name);
+            }
+            tracer->kernels.insert(data->kernel_id, &kernel_name);
         } else if (record.phase == ROCPROFILER_CALLBACK_PHASE_UNLOAD) {
-            ROCPROFILER_CALL(rocprofiler_flush_buffer(tracer->buffer), "flush buffer");
+            for (auto buffer : tracer->buffers) {
+                ROCPROFILER_CALL(rocprofiler_flush_buffer(buffer), "flush buffer");
+            }
             tracer->kernels.erase(data->kernel_id);
         }
     }
 }
 
 void full_buffer_callback(rocprofiler_context_id_t context [[maybe_unused]],
-                          rocprofiler_buffer_id_t buffer_id [[maybe_unused]],
-                          rocprofiler_record_header_t** headers, size_t num_headers,
-                          void* tool_data, uint64_t drop_count [[maybe_unused]]) {
+                          rocprofiler_buffer_id_t buffer_id, rocprofiler_record_header_t** headers,
+                          size_t num_headers, void* tool_data, uint64_t drop_count) {
     auto* tracer = static_cast<KernelTracer*>(tool_data);
 
+    // In per-agent mode every context receives all dispatch records
+    // (rocprofiler has no per-agent filter for buffer tracing services), so
+    // each buffer handles only the records of its assigned agent
+    const bool per_agent = tracer->per_agent_enabled;
+    const uint64_t assigned_agent = per_agent ? tracer->buffer_agents.at(buffer_id.handle) : 0;
+
+    // Records the lossy buffer policy discarded because the consumer fell
+    // behind; only non-zero when sampling mode is enabled
+    if (drop_count > 0) {
+        tracer->record_buffer_drops(drop_count);
+    }
+
     if (num_headers == 0) {
         throw std::runtime_error{
             "rocprofiler invoked a buffer callback with no headers. this should never happen"};
@@ -97,15 +188,71 @@ void full_buffer_callback(rocprofiler_context_id_t context [[maybe_unused]],
                                  "array of headers. this should never happen"};
     }
 
+    // In aggregation mode nothing is serialized here: records are folded
+    // into the per-kernel table and flushed on the periodic interval
+    if (tracer->aggregate_enabled) {
+        for (size_t i = 0; i < num_headers; ++i) {
+            auto* header = headers[i];
+
+            if (header->category == ROCPROFILER_BUFFER_CATEGORY_TRACING &&
+                header->kind == ROCPROFILER_BUFFER_TRACING_KERNEL_DISPATCH) {
+                auto* record = static_cast<rocprofiler_buffer_tracing_kernel_dispatch_record_t*>(
+                    header->payload);
+                // Agent filtering happens before the sampling decision so
+                // decimation isn't skewed by records other buffers handle
+                if (per_agent && record->dispatch_info.agent_id.handle != assigned_agent) {
+                    continue;
+                }
+                if (!tracer->sample_dispatch()) {
+                    continue;
+                }
+                auto gpu_id = tracer->agents.at(record->dispatch_info.agent_id.handle);
+                auto duration_ns = record->end_timestamp - record->start_timestamp;
+                tracer->accumulate(gpu_id, record->dispatch_info.kernel_id, duration_ns);
+                if (tracer->windows_enabled) {
+                    tracer->accumulate_window(gpu_id, record->dispatch_info.kernel_id, duration_ns);
+                }
+            } else {
+                throw std::runtime_error{
+                    fmt::format("unexpected rocprofiler_record_header_t category + kind: ({} + {})",
+                                header->category, header->kind)};
+            }
+        }
+        return;
+    }
+
     // Estimate bytes per record to reserve memory upfront. Likely
     // overestimating, but some kernel names can be very long (>700 bytes).
     constexpr size_t max_bytes_per_record = 1024;
 
-    std::string data;
+    const auto serialize_start = std::chrono::steady_clock::now();
+
+    // Serialize into a recycled arena buffer; after warm-up the reserve is a
+    // no-op and the flush path performs no heap allocation
+    std::string data = tracer->acquire_buffer();
     data.reserve(num_headers * max_bytes_per_record);
 
-    // Start JSON array
-    data.push_back('[');
+    if (tracer->format == TraceFormat::Binary) {
+        // The record count is patched in after the loop since sampling mode
+        // may skip dispatches
+        uint8_t flags = tracer->dictionary_enabled ? BINARY_FLAG_KERNEL_IDS : 0;
+        append_binary_header(data, 0, flags, tracer->client_id());
+    } else if (tracer->dictionary_enabled) {
+        // Start JSON object identifying the client whose dictionary resolves
+        // the kernel IDs referenced by the records
+        fmt::format_to(std::back_inserter(data), "{{\"client\":{},\"records\":[",
+                       tracer->client_id());
+    } else {
+        // Start JSON array
+        data.push_back('[');
+    }
+
+    size_t num_emitted = 0;
+
+    // Time range covered by the emitted dispatches; recorded per block when
+    // writing to the local trace file so readers can index by time
+    uint64_t min_timestamp = UINT64_MAX;
+    uint64_t max_timestamp = 0;
 
     for (size_t i = 0; i < num_headers; ++i) {
         auto* header = headers[i];
@@ -115,11 +262,50 @@ void full_buffer_callback(rocprofiler_context_id_t context [[maybe_unused]],
             auto* record =
                 static_cast<rocprofiler_buffer_tracing_kernel_dispatch_record_t*>(header->payload);
 
-            // Build array element: [gpu_id, "kernel_name", start_ns, end_ns]
-            fmt::format_to(std::back_inserter(data), "[{},\"{}\",{},{}],",
-                           tracer->agents.at(record->dispatch_info.agent_id.handle),
-                           tracer->kernels.at(record->dispatch_info.kernel_id),
-                           record->start_timestamp, record->end_timestamp);
+            if (per_agent && record->dispatch_info.agent_id.handle != assigned_agent) {
+                continue;
+            }
+            if (!tracer->sample_dispatch()) {
+                continue;
+            }
+
+            auto gpu_id = tracer->agents.at(record->dispatch_info.agent_id.handle);
+            auto kernel_id = record->dispatch_info.kernel_id;
+
+            min_timestamp = std::min(min_timestamp, record->start_timestamp);
+            max_timestamp = std::max(max_timestamp, record->end_timestamp);
+
+            if (tracer->windows_enabled) {
+                tracer->accumulate_window(gpu_id, kernel_id,
+                                          record->end_timestamp - record->start_timestamp);
+            }
+
+            if (tracer->dictionary_enabled) {
+                if (tracer->format == TraceFormat::Binary) {
+                    append_binary_id_record(data, gpu_id, kernel_id, record->start_timestamp,
+                                            record->end_timestamp);
+                } else {
+                    append_json_id_record(data, gpu_id, kernel_id, record->start_timestamp,
+                                          record->end_timestamp);
+                }
+            } else {
+                // A concurrent unload may have removed the kernel between the
+                // dispatch and this flush; keep the record with a placeholder
+                const auto* kernel_name = tracer->kernels.find(kernel_id);
+                std::string placeholder;
+                if (kernel_name == nullptr) {
+                    placeholder = fmt::format("unknown_kernel_{}", kernel_id);
+                    kernel_name = &placeholder;
+                }
+                if (tracer->format == TraceFormat::Binary) {
+                    append_binary_record(data, gpu_id, *kernel_name, record->start_timestamp,
+                                         record->end_timestamp);
+                } else {
+                    append_json_record(data, gpu_id, *kernel_name, record->start_timestamp,
+                                       record->end_timestamp);
+                }
+            }
+            ++num_emitted;
         } else {
             throw std::runtime_error{
                 fmt::format("unexpected rocprofiler_record_header_t category + kind: ({} + {})",
@@ -127,23 +313,84 @@ void full_buffer_callback(rocprofiler_context_id_t context [[maybe_unused]],
         }
     }
 
-    // Replace trailing comma with closing bracket
-    data.back() = ']';
+    tracer->record_serialization(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - serialize_start)
+                                     .count());
 
-    if (!tracer->flush(data, num_headers)) {
-        std::cerr << "Omnistat: failed to post kernel trace data" << std::endl;
+    // Sampling may skip every dispatch in a small flush
+    if (num_emitted == 0) {
+        tracer->recycle_buffer(std::move(data));
+        return;
     }
+
+    if (tracer->format == TraceFormat::Binary) {
+        patch_binary_record_count(data, static_cast<uint32_t>(num_emitted));
+    } else {
+        // Replace trailing comma with closing bracket
+        data.back() = ']';
+        if (tracer->dictionary_enabled) {
+            data.push_back('}');
+        }
+    }
+
+    if (tracer->file_sink_enabled()) {
+        tracer->write_block(data, num_emitted, min_timestamp, max_timestamp);
+        tracer->recycle_buffer(std::move(data));
+        return;
+    }
+
+    tracer->enqueue(std::move(data), num_emitted);
 }
 
 KernelTracer::KernelTracer()
     : periodic_flush_interval_(std::chrono::seconds(
           parse_env_uint("OMNISTAT_TRACE_MAX_INTERVAL", DEFAULT_FLUSH_INTERVAL_SECONDS))),
+      target_payload_bytes_(
+          parse_env_uint("OMNISTAT_TRACE_TARGET_PAYLOAD", DEFAULT_TARGET_PAYLOAD_BYTES, true)),
       buffer_size_bytes_(parse_env_uint("OMNISTAT_TRACE_BUFFER_SIZE", DEFAULT_BUFFER_SIZE_BYTES)),
       endpoint_port_(parse_env_uint("OMNISTAT_TRACE_ENDPOINT_PORT", DEFAULT_TRACE_ENDPOINT_PORT)),
+      send_queue_depth_(
+          parse_env_uint("OMNISTAT_TRACE_QUEUE_DEPTH", DEFAULT_SEND_QUEUE_DEPTH, true)),
+      curl_timeout_ms_(parse_env_uint("OMNISTAT_TRACE_TIMEOUT", DEFAULT_CURL_TIMEOUT_MS)),
+      flush_retries_(parse_env_uint("OMNISTAT_TRACE_RETRIES", DEFAULT_FLUSH_RETRIES, true)),
+      sampling_rate_(parse_env_uint("OMNISTAT_TRACE_SAMPLING", 1)),
       log_enabled_(parse_env_uint("OMNISTAT_TRACE_LOG", 0) != 0) {
+    format = parse_trace_format();
+    dictionary_enabled = parse_env_uint("OMNISTAT_TRACE_DICTIONARY", 0) != 0;
+    aggregate_enabled = parse_env_uint("OMNISTAT_TRACE_AGGREGATE", 0) != 0;
+    per_agent_enabled = parse_env_uint("OMNISTAT_TRACE_PER_AGENT", 0) != 0;
+    client_id_ = static_cast<uint32_t>(getpid());
+
+    // Fifo carrying application phase markers (omnistat-annotate); when set,
+    // dispatches are additionally rolled up per annotation window
+    const char* annotation_fifo = std::getenv("OMNISTAT_TRACE_ANNOTATIONS");
+    if (annotation_fifo != nullptr && annotation_fifo[0] != '\0') {
+        annotation_fifo_path_ = annotation_fifo;
+        windows_enabled = true;
+    }
+
+    // Local trace file sink for runs without a live collector endpoint.
+    // Blocks hold binary record payloads, and the endpoint-oriented modes
+    // (dictionary sync, aggregation) don't apply.
+    const char* trace_file = std::getenv("OMNISTAT_TRACE_FILE");
+    if (trace_file != nullptr && trace_file[0] != '\0') {
+        trace_file_path_ = trace_file;
+        if (dictionary_enabled || aggregate_enabled || windows_enabled) {
+            std::cerr << "Omnistat: OMNISTAT_TRACE_FILE is set, ignoring dictionary/aggregation/"
+                         "annotation modes"
+                      << std::endl;
+        }
+        format = TraceFormat::Binary;
+        dictionary_enabled = false;
+        aggregate_enabled = false;
+        windows_enabled = false;
+    }
 }
 
-int KernelTracer::initialize() {
+// Bring up the HTTP posting machinery: libcurl handle, endpoint URLs,
+// content headers, optional compression, and the spill ring. Skipped
+// entirely when the local trace file sink is active.
+int KernelTracer::initialize_endpoint() {
     curl_global_init(CURL_GLOBAL_ALL);
 
     curl_handle_ = curl_easy_init();
@@ -152,13 +399,94 @@ int KernelTracer::initialize() {
         return -1;
     }
 
-    std::string url = fmt::format("http://localhost:{}/kernel_trace", endpoint_port_);
-    curl_easy_setopt(curl_handle_, CURLOPT_URL, url.c_str());
-    struct curl_slist* http_headers = NULL;
-    http_headers = curl_slist_append(http_headers, "Content-Type: application/json");
-    curl_easy_setopt(curl_handle_, CURLOPT_HTTPHEADER, http_headers);
+    // Prefer a Unix domain socket to the local endpoint when configured:
+    // it avoids the loopback TCP stack, which is measurable overhead with
+    // many ranks per node and competes with application networking. The
+    // HTTP-over-TCP path remains the default and works with remote
+    // endpoints.
+    const char* socket_path = std::getenv("OMNISTAT_TRACE_SOCKET");
+    if (socket_path != nullptr && socket_path[0] != '\0') {
+        curl_easy_setopt(curl_handle_, CURLOPT_UNIX_SOCKET_PATH, socket_path);
+        // Host is ignored when the connection goes through the socket
+        trace_url_ = "http://localhost/kernel_trace";
+    } else {
+        trace_url_ = fmt::format("http://localhost:{}/kernel_trace", endpoint_port_);
+    }
+    dict_url_ = trace_url_ + "/dict";
+    health_url_ = trace_url_ + "/health";
+
+    json_headers_ = curl_slist_append(NULL, "Content-Type: application/json");
+    if (format == TraceFormat::Binary) {
+        std::string content_type = fmt::format("Content-Type: {}", BINARY_CONTENT_TYPE);
+        trace_headers_ = curl_slist_append(NULL, content_type.c_str());
+    } else {
+        trace_headers_ = json_headers_;
+    }
+
+    // Optional zstd compression of flush payloads: kernel-name-heavy JSON
+    // compresses ~15x, directly cutting loopback bandwidth and endpoint
+    // parse time. The compression context is created once and reused.
+    if (parse_env_uint("OMNISTAT_TRACE_COMPRESS", 0) != 0) {
+#if defined(HAS_ZSTD)
+        zstd_cctx_ = ZSTD_createCCtx();
+        json_headers_ = curl_slist_append(json_headers_, "Content-Encoding: zstd");
+        if (format == TraceFormat::Binary) {
+            trace_headers_ = curl_slist_append(trace_headers_, "Content-Encoding: zstd");
+        } else {
+            trace_headers_ = json_headers_;
+        }
+#else
+        std::cerr << "Omnistat: OMNISTAT_TRACE_COMPRESS set but the library was built without "
+                     "zstd, sending uncompressed"
+                  << std::endl;
+#endif
+    }
+
     curl_easy_setopt(curl_handle_, CURLOPT_WRITEFUNCTION, &omnistat::write_callback);
 
+    // Bound how long any single POST can hold up a flush: a hung endpoint
+    // must never wedge record processing for the whole job. NOSIGNAL is
+    // required for timeouts from threads other than main.
+    curl_easy_setopt(curl_handle_, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl_handle_, CURLOPT_TIMEOUT_MS, static_cast<long>(curl_timeout_ms_));
+    curl_easy_setopt(curl_handle_, CURLOPT_CONNECTTIMEOUT_MS,
+                     static_cast<long>(curl_timeout_ms_));
+
+    // Keep the pooled connection alive across flush intervals so gunicorn
+    // worker cycling doesn't add re-establishment latency to every flush
+    curl_easy_setopt(curl_handle_, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl_handle_, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(curl_handle_, CURLOPT_TCP_KEEPINTVL, 15L);
+
+    // Optional node-local spill file: payloads that fail to flush are
+    // appended to a bounded mmap ring and replayed by the periodic thread
+    // once the endpoint recovers, instead of being dropped
+    const char* spill_path = std::getenv("OMNISTAT_TRACE_SPILL_FILE");
+    if (spill_path != nullptr && spill_path[0] != '\0') {
+        auto spill_size = parse_env_uint("OMNISTAT_TRACE_SPILL_SIZE", DEFAULT_SPILL_SIZE_BYTES);
+        spill_ring_ = std::make_unique<SpillRing>(spill_path, spill_size);
+        if (!spill_ring_->valid()) {
+            spill_ring_.reset();
+        }
+    }
+
+    return 0;
+}
+
+int KernelTracer::initialize() {
+    // Endpoint-less runs write indexed blocks to the local trace file and
+    // never bring up the HTTP machinery (curl, sender thread, spill ring)
+    if (!trace_file_path_.empty()) {
+        trace_file_ = std::make_unique<TraceFileSink>();
+        if (!trace_file_->open(trace_file_path_)) {
+            std::cerr << "Omnistat: failed to create trace file " << trace_file_path_ << std::endl;
+            trace_file_.reset();
+            return -1;
+        }
+    } else if (initialize_endpoint() != 0) {
+        return -1;
+    }
+
     agents = omnistat::build_agent_map();
 
     ROCPROFILER_CALL(rocprofiler_create_context(&context_), "create context");
@@ -173,20 +501,66 @@ int KernelTracer::initialize() {
 
     const auto buffer_watermark_bytes = buffer_size_bytes_ - (buffer_size_bytes_ / 8);
 
-    ROCPROFILER_CALL(rocprofiler_create_buffer(context_, buffer_size_bytes_, buffer_watermark_bytes,
-                                               ROCPROFILER_BUFFER_POLICY_LOSSLESS,
-                                               full_buffer_callback, this, &buffer),
-                     "create buffer");
+    // With the default LOSSLESS policy a slow consumer back-pressures the
+    // application. When sampling is enabled the goal is a fixed overhead
+    // budget instead of complete data, so switch to the lossy policy and let
+    // rocprofiler discard records if we fall behind; drops are reported via
+    // the drop_count argument of the buffer callback.
+    const auto buffer_policy = sampling_rate_ > 1 ? ROCPROFILER_BUFFER_POLICY_DISCARD
+                                                  : ROCPROFILER_BUFFER_POLICY_LOSSLESS;
+
+    if (per_agent_enabled && agents.size() > 1) {
+        // Per-agent mode: one context, buffer, and callback thread per GPU so
+        // serialization and flushing parallelize across agents. rocprofiler
+        // has no per-agent filter for buffer tracing services, so each
+        // context receives all dispatch records and the buffer callback
+        // filters to the buffer's assigned agent.
+        for (const auto& [agent_handle, gpu_id] : agents) {
+            auto agent_context = rocprofiler_context_id_t{.handle = 0};
+            ROCPROFILER_CALL(rocprofiler_create_context(&agent_context), "create agent context");
+
+            auto agent_buffer = rocprofiler_buffer_id_t{};
+            ROCPROFILER_CALL(rocprofiler_create_buffer(agent_context, buffer_size_bytes_,
+                                                       buffer_watermark_bytes, buffer_policy,
+                                                       full_buffer_callback, this, &agent_buffer),
+                             "create agent buffer");
 
-    ROCPROFILER_CALL(rocprofiler_configure_buffer_tracing_service(
-                         context_, ROCPROFILER_BUFFER_TRACING_KERNEL_DISPATCH, nullptr, 0, buffer),
-                     "configure buffer tracing service for kernel dispatches");
+            ROCPROFILER_CALL(rocprofiler_configure_buffer_tracing_service(
+                                 agent_context, ROCPROFILER_BUFFER_TRACING_KERNEL_DISPATCH, nullptr,
+                                 0, agent_buffer),
+                             "configure buffer tracing service for kernel dispatches");
 
-    auto thread = rocprofiler_callback_thread_t{};
-    ROCPROFILER_CALL(rocprofiler_create_callback_thread(&thread), "create thread");
+            auto thread = rocprofiler_callback_thread_t{};
+            ROCPROFILER_CALL(rocprofiler_create_callback_thread(&thread), "create thread");
+            ROCPROFILER_CALL(rocprofiler_assign_callback_thread(agent_buffer, thread),
+                             "assign thread for agent buffer");
 
-    ROCPROFILER_CALL(rocprofiler_assign_callback_thread(buffer, thread),
-                     "assign thread for buffer");
+            buffer_agents.emplace(agent_buffer.handle, agent_handle);
+            buffers.push_back(agent_buffer);
+            agent_contexts_.push_back(agent_context);
+        }
+    } else {
+        per_agent_enabled = false;
+
+        auto buffer = rocprofiler_buffer_id_t{};
+        ROCPROFILER_CALL(rocprofiler_create_buffer(context_, buffer_size_bytes_,
+                                                   buffer_watermark_bytes, buffer_policy,
+                                                   full_buffer_callback, this, &buffer),
+                         "create buffer");
+
+        ROCPROFILER_CALL(
+            rocprofiler_configure_buffer_tracing_service(
+                context_, ROCPROFILER_BUFFER_TRACING_KERNEL_DISPATCH, nullptr, 0, buffer),
+            "configure buffer tracing service for kernel dispatches");
+
+        auto thread = rocprofiler_callback_thread_t{};
+        ROCPROFILER_CALL(rocprofiler_create_callback_thread(&thread), "create thread");
+
+        ROCPROFILER_CALL(rocprofiler_assign_callback_thread(buffer, thread),
+                         "assign thread for buffer");
+
+        buffers.push_back(buffer);
+    }
 
     int valid = 0;
     ROCPROFILER_CALL(rocprofiler_context_is_valid(context_, &valid), "check context validity");
@@ -196,9 +570,43 @@ int KernelTracer::initialize() {
 
     ROCPROFILER_CALL(rocprofiler_start_context(context_), "start context");
 
+    for (auto agent_context : agent_contexts_) {
+        valid = 0;
+        ROCPROFILER_CALL(rocprofiler_context_is_valid(agent_context, &valid),
+                         "check agent context validity");
+        if (valid == 0) {
+            return -1;
+        }
+        ROCPROFILER_CALL(rocprofiler_start_context(agent_context), "start agent context");
+    }
+
     record_flush_time();
     periodic_thread_ = std::thread(&KernelTracer::periodic_flush, this);
 
+    if (send_queue_depth_ > 0 && !file_sink_enabled()) {
+        sender_thread_ = std::thread(&KernelTracer::sender_loop, this);
+    }
+
+    if (windows_enabled) {
+        // Create the fifo if the annotator hasn't; the writer side
+        // (omnistat-annotate) opens it non-blocking and transiently, so the
+        // read end is held open here for the lifetime of the process
+        if (mkfifo(annotation_fifo_path_.c_str(), 0622) != 0 && errno != EEXIST) {
+            std::cerr << "Omnistat: failed to create annotation fifo " << annotation_fifo_path_
+                      << ", disabling window roll-ups" << std::endl;
+            windows_enabled = false;
+        } else {
+            annotation_fd_ = open(annotation_fifo_path_.c_str(), O_RDONLY | O_NONBLOCK);
+            if (annotation_fd_ < 0) {
+                std::cerr << "Omnistat: failed to open annotation fifo " << annotation_fifo_path_
+                          << ", disabling window roll-ups" << std::endl;
+                windows_enabled = false;
+            } else {
+                annotation_thread_ = std::thread(&KernelTracer::annotation_loop, this);
+            }
+        }
+    }
+
     return 0;
 }
 
@@ -209,76 +617,715 @@ KernelTracer::~KernelTracer() {
     }
     periodic_cv_.notify_one();
 
-    if (periodic_thread_.joinable()) {
+    bool was_initialized = periodic_thread_.joinable();
+    if (was_initialized) {
         periodic_thread_.join();
+    }
+
+    // The annotation thread checks stop_requested_ on every poll cycle; a
+    // window left open at exit is closed and emitted like any other
+    if (annotation_thread_.joinable()) {
+        annotation_thread_.join();
+        close_window();
+        close(annotation_fd_);
+    }
+
+    // Send any remaining aggregated data before stopping the sender
+    if (aggregate_enabled) {
+        flush_aggregate();
+    }
+
+    // Stop the sender after the periodic thread so no new payloads are
+    // enqueued; the sender drains any queued payloads before exiting.
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        sender_stop_requested_ = true;
+    }
+    queue_cv_.notify_one();
+
+    if (sender_thread_.joinable()) {
+        sender_thread_.join();
+    }
+
+    // Finalize the trace file: write the footer index and trim the mapping
+    if (trace_file_) {
+        trace_file_->close();
+    }
+
+    if (log_enabled_ && was_initialized) {
+        char hostname[256];
+        gethostname(hostname, sizeof(hostname));
+
+        auto successful_records = total_records_ - failed_records_;
+        auto successful_flushes = total_flushes_ - failed_flushes_;
+        std::cout << "[" << hostname << "][" << getpid()
+                  << "][omnistat] Trace summary: " << successful_records << "/" << total_records_
+                  << " processed records (" << successful_flushes << "/" << total_flushes_
+                  << " successful flushes, " << overflow_records_
+                  << " records dropped on queue overflow)" << std::endl;
 
-        if (log_enabled_) {
-            char hostname[256];
-            gethostname(hostname, sizeof(hostname));
+        if (trace_file_) {
+            std::cout << "[" << hostname << "][" << getpid()
+                      << "][omnistat] Trace file summary: " << trace_file_->blocks_written()
+                      << " blocks (" << trace_file_->bytes_written() << " payload bytes) written to "
+                      << trace_file_path_ << std::endl;
+        }
 
-            auto successful_records = total_records_ - failed_records_;
-            auto successful_flushes = total_flushes_ - failed_flushes_;
+        if (sampling_rate_ > 1) {
+            auto seen = sample_counter_.load() + buffer_dropped_records_.load();
             std::cout << "[" << hostname << "][" << getpid()
-                      << "][omnistat] Trace summary: " << successful_records << "/"
-                      << total_records_ << " processed records (" << successful_flushes << "/"
-                      << total_flushes_ << " successful flushes)" << std::endl;
+                      << "][omnistat] Sampling summary: kept 1/" << sampling_rate_
+                      << " dispatches (" << total_records_ << "/" << seen << " kept, "
+                      << sampled_out_records_ << " sampled out, " << buffer_dropped_records_
+                      << " dropped by lossy buffer)" << std::endl;
         }
     }
 
     if (curl_handle_) {
         curl_easy_cleanup(curl_handle_);
     }
+#if defined(HAS_ZSTD)
+    if (zstd_cctx_) {
+        ZSTD_freeCCtx(zstd_cctx_);
+    }
+#endif
+    if (trace_headers_ && trace_headers_ != json_headers_) {
+        curl_slist_free_all(trace_headers_);
+    }
+    if (json_headers_) {
+        curl_slist_free_all(json_headers_);
+    }
 }
 
-bool KernelTracer::flush(std::string_view data, size_t num_records) {
+FlushResult KernelTracer::flush(std::string_view data, size_t num_records, bool as_json) {
     record_flush_time();
 
+    // Sync any newly registered kernel names before sending records that
+    // reference them by ID. On failure the entries stay queued and records
+    // are sent anyway; the endpoint reports unresolved IDs with placeholder
+    // names until the next successful sync.
+    if (dictionary_enabled) {
+        send_pending_dictionary();
+    }
+
+    FlushResult result = post(data, trace_url_, as_json ? json_headers_ : trace_headers_);
+
+    record_flush_stats(num_records, result != FlushResult::Success);
+    total_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+    return result;
+}
+
+void KernelTracer::write_block(std::string_view data, size_t num_records, uint64_t min_timestamp,
+                               uint64_t max_timestamp) {
+    record_flush_time();
+
+    // Sequential mmap appends are cheap enough to run directly on the
+    // buffer callback thread; no sender queue is involved
+    bool success = trace_file_->append_block(data, min_timestamp, max_timestamp,
+                                             static_cast<uint32_t>(num_records));
+
+    record_flush_stats(num_records, !success);
+    total_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+}
+
+void KernelTracer::enqueue(std::string&& data, size_t num_records, bool as_json) {
+    if (send_queue_depth_ == 0) {
+        FlushResult result = flush(data, num_records, as_json);
+        if (result != FlushResult::Success) {
+            std::cerr << "Omnistat: failed to post kernel trace data" << std::endl;
+            // Rejected payloads would fail identically on replay; only spill
+            // failures the endpoint might accept later
+            if (result == FlushResult::Failed) {
+                spill_payload(data, num_records, as_json);
+            }
+        }
+        recycle_buffer(std::move(data));
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+
+        // Drop the oldest payload on overflow: keeping the freshest records
+        // bounds sender backlog (and memory) when the endpoint falls behind
+        if (send_queue_.size() >= send_queue_depth_) {
+            overflow_flushes_.fetch_add(1, std::memory_order_relaxed);
+            overflow_records_.fetch_add(send_queue_.front().num_records,
+                                        std::memory_order_relaxed);
+            record_flush_stats(send_queue_.front().num_records, true);
+            recycle_buffer(std::move(send_queue_.front().data));
+            send_queue_.pop_front();
+        }
+
+        send_queue_.push_back(FlushPayload{std::move(data), num_records, as_json});
+    }
+    queue_cv_.notify_one();
+}
+
+void KernelTracer::sender_loop() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        queue_cv_.wait(lock, [this] { return !send_queue_.empty() || sender_stop_requested_; });
+
+        if (send_queue_.empty()) {
+            // Stop requested and the queue has been drained
+            break;
+        }
+
+        FlushPayload payload = std::move(send_queue_.front());
+        send_queue_.pop_front();
+        lock.unlock();
+
+        FlushResult result = flush(payload.data, payload.num_records, payload.as_json);
+        if (result != FlushResult::Success) {
+            std::cerr << "Omnistat: failed to post kernel trace data" << std::endl;
+            if (result == FlushResult::Failed) {
+                spill_payload(payload.data, payload.num_records, payload.as_json);
+            }
+        }
+        recycle_buffer(std::move(payload.data));
+    }
+}
+
+void KernelTracer::spill_payload(std::string_view data, size_t num_records, bool as_json) {
+    if (!spill_ring_) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(spill_mutex_);
+    spill_ring_->append(data, static_cast<uint32_t>(num_records), as_json);
+}
+
+void KernelTracer::replay_spilled() {
+    if (!spill_ring_) {
+        return;
+    }
+
+    // Replay in order, keeping each entry in the ring until its flush
+    // succeeds; stop at the first transient failure and retry on the next
+    // interval. Entries the endpoint definitively rejects (e.g. spilled
+    // under a previous run's wire format) are dropped — they would fail
+    // identically every cycle and wedge the ring head forever.
+    std::string data = acquire_buffer();
+    uint32_t num_records = 0;
+    bool as_json = false;
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(spill_mutex_);
+            if (!spill_ring_->peek(data, num_records, as_json)) {
+                break;
+            }
+        }
+
+        FlushResult result = flush(data, num_records, as_json);
+        if (result == FlushResult::Failed) {
+            break;
+        }
+        if (result == FlushResult::Rejected) {
+            std::cerr << "Omnistat: dropping spilled payload rejected by the endpoint"
+                      << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(spill_mutex_);
+        spill_ring_->pop();
+    }
+
+    recycle_buffer(std::move(data));
+}
+
+bool KernelTracer::sample_dispatch() {
+    if (sampling_rate_ <= 1) {
+        return true;
+    }
+
+    auto count = sample_counter_.fetch_add(1, std::memory_order_relaxed);
+    if (count % sampling_rate_ != 0) {
+        sampled_out_records_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void KernelTracer::record_buffer_drops(uint64_t drop_count) {
+    buffer_dropped_records_.fetch_add(drop_count, std::memory_order_relaxed);
+}
+
+std::string KernelTracer::acquire_buffer() {
+    std::lock_guard<std::mutex> lock(buffer_pool_mutex_);
+
+    if (buffer_pool_.empty()) {
+        return {};
+    }
+    std::string buffer = std::move(buffer_pool_.back());
+    buffer_pool_.pop_back();
+    return buffer;
+}
+
+void KernelTracer::recycle_buffer(std::string&& buffer) {
+    // clear() keeps the allocation, so pooled buffers settle at the
+    // high-water payload size and steady-state flushes never touch the heap
+    buffer.clear();
+
+    std::lock_guard<std::mutex> lock(buffer_pool_mutex_);
+    if (buffer_pool_.size() < MAX_POOLED_FLUSH_BUFFERS) {
+        buffer_pool_.push_back(std::move(buffer));
+    }
+}
+
+void KernelTracer::record_serialization(uint64_t elapsed_ns) {
+    serialize_ns_.fetch_add(elapsed_ns, std::memory_order_relaxed);
+}
+
+void KernelTracer::record_post_latency(uint64_t elapsed_ns) {
+    post_ns_.fetch_add(elapsed_ns, std::memory_order_relaxed);
+    post_attempts_.fetch_add(1, std::memory_order_relaxed);
+
+    // Same log-scale bucketing as kernel durations, in microseconds;
+    // bit_width(0) is 0, so force a minimum width of one
+    auto elapsed_us = elapsed_ns / 1000;
+    auto bucket = std::min<size_t>(std::bit_width(elapsed_us | 1), NUM_LATENCY_BUCKETS) - 1;
+    post_latency_buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string KernelTracer::build_health_payload() {
+    size_t queue_depth = 0;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        queue_depth = send_queue_.size();
+    }
+
+    std::string data;
+    fmt::format_to(
+        std::back_inserter(data),
+        "{{\"client\":{},\"health\":{{"
+        "\"records\":{},\"flushes\":{},\"failed_records\":{},\"failed_flushes\":{},"
+        "\"payload_bytes\":{},\"serialize_ns\":{},\"post_ns\":{},\"post_attempts\":{},"
+        "\"queue_depth\":{},\"queue_overflow_records\":{},"
+        "\"buffer_dropped_records\":{},\"sampled_out_records\":{},"
+        "\"post_latency_us_buckets\":[",
+        client_id_, total_records_.load(std::memory_order_relaxed),
+        total_flushes_.load(std::memory_order_relaxed),
+        failed_records_.load(std::memory_order_relaxed),
+        failed_flushes_.load(std::memory_order_relaxed),
+        total_bytes_.load(std::memory_order_relaxed),
+        serialize_ns_.load(std::memory_order_relaxed), post_ns_.load(std::memory_order_relaxed),
+        post_attempts_.load(std::memory_order_relaxed), queue_depth,
+        overflow_records_.load(std::memory_order_relaxed),
+        buffer_dropped_records_.load(std::memory_order_relaxed),
+        sampled_out_records_.load(std::memory_order_relaxed));
+
+    // Trim trailing empty buckets, matching the aggregate histograms
+    size_t last_bucket = NUM_LATENCY_BUCKETS;
+    while (last_bucket > 0 && post_latency_buckets_[last_bucket - 1].load(std::memory_order_relaxed) == 0) {
+        --last_bucket;
+    }
+    for (size_t b = 0; b < last_bucket; ++b) {
+        fmt::format_to(std::back_inserter(data), "{},",
+                       post_latency_buckets_[b].load(std::memory_order_relaxed));
+    }
+    if (last_bucket > 0) {
+        data.back() = ']';
+    } else {
+        data.push_back(']');
+    }
+    data.append("}}");
+
+    return data;
+}
+
+// Push the live health counters to the endpoint; best effort, never counted
+// in flush statistics so a down endpoint doesn't inflate its own failures
+void KernelTracer::send_health() {
+    post(build_health_payload(), health_url_, json_headers_);
+}
+
+void KernelTracer::accumulate(uint32_t gpu_id, uint64_t kernel_id, uint64_t duration_ns) {
+    std::lock_guard<std::mutex> lock(aggregate_mutex_);
+
+    auto& stats = aggregate_[{gpu_id, kernel_id}];
+    stats.count += 1;
+    stats.total_ns += duration_ns;
+    stats.min_ns = std::min(stats.min_ns, duration_ns);
+    stats.max_ns = std::max(stats.max_ns, duration_ns);
+
+    // bit_width(0) is 0; force a minimum width of one so the index is valid
+    auto bucket = std::min<size_t>(std::bit_width(duration_ns | 1), NUM_DURATION_BUCKETS) - 1;
+    stats.buckets[bucket] += 1;
+}
+
+void KernelTracer::accumulate_window(uint32_t gpu_id, uint64_t kernel_id, uint64_t duration_ns) {
+    std::lock_guard<std::mutex> lock(window_mutex_);
+
+    // Dispatches between annotation windows are not rolled up
+    if (window_label_.empty()) {
+        return;
+    }
+
+    auto& stats = window_table_[{gpu_id, kernel_id}];
+    stats.count += 1;
+    stats.total_ns += duration_ns;
+    stats.min_ns = std::min(stats.min_ns, duration_ns);
+    stats.max_ns = std::max(stats.max_ns, duration_ns);
+
+    auto bucket = std::min<size_t>(std::bit_width(duration_ns | 1), NUM_DURATION_BUCKETS) - 1;
+    stats.buckets[bucket] += 1;
+}
+
+// Serialize a per-kernel stats table as a JSON array of entries of the form
+// [gpu_id, kernel, count, total_ns, min_ns, max_ns, [buckets]], returning the
+// total dispatch count covered. The table must be non-empty.
+size_t KernelTracer::append_aggregate_entries(
+    std::string& data, const std::map<std::pair<uint32_t, uint64_t>, KernelStats>& table) {
+    size_t num_records = 0;
+
+    data.push_back('[');
+    for (const auto& [key, stats] : table) {
+        const auto& [gpu_id, kernel_id] = key;
+
+        if (dictionary_enabled) {
+            fmt::format_to(std::back_inserter(data), "[{},{},", gpu_id, kernel_id);
+        } else {
+            const auto* kernel_name = kernels.find(kernel_id);
+            fmt::format_to(std::back_inserter(data), "[{},\"", gpu_id);
+            if (kernel_name != nullptr) {
+                append_json_escaped(data, *kernel_name);
+            } else {
+                fmt::format_to(std::back_inserter(data), "unknown_kernel_{}", kernel_id);
+            }
+            data.append("\",");
+        }
+
+        fmt::format_to(std::back_inserter(data), "{},{},{},{},[", stats.count, stats.total_ns,
+                       stats.min_ns, stats.max_ns);
+
+        // Trim trailing empty buckets to keep the payload compact
+        size_t last_bucket = NUM_DURATION_BUCKETS;
+        while (last_bucket > 0 && stats.buckets[last_bucket - 1] == 0) {
+            --last_bucket;
+        }
+        for (size_t b = 0; b < last_bucket; ++b) {
+            fmt::format_to(std::back_inserter(data), "{},", stats.buckets[b]);
+        }
+        if (last_bucket > 0) {
+            data.back() = ']';
+        } else {
+            data.push_back(']');
+        }
+        data.append("],");
+
+        num_records += stats.count;
+    }
+    data.back() = ']';
+
+    return num_records;
+}
+
+void KernelTracer::flush_aggregate() {
+    std::map<std::pair<uint32_t, uint64_t>, KernelStats> table;
+    {
+        std::lock_guard<std::mutex> lock(aggregate_mutex_);
+        table.swap(aggregate_);
+    }
+
+    if (table.empty()) {
+        return;
+    }
+
+    // Aggregate payloads are always JSON: they are a few kilobytes per flush
+    // regardless of dispatch count, so the binary encoding buys nothing
+    std::string data = acquire_buffer();
+    fmt::format_to(std::back_inserter(data), "{{\"client\":{},\"aggregate\":", client_id_);
+    size_t num_records = append_aggregate_entries(data, table);
+    data.push_back('}');
+
+    enqueue(std::move(data), num_records, true);
+}
+
+// Timestamp on the clock rocprofiler uses for dispatch records, so window
+// boundaries and kernel timestamps are directly comparable
+static uint64_t boottime_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Read newline-delimited phase markers from the annotation fifo: "start
+// <label>" opens a roll-up window (closing any open one), "stop" closes it.
+// Marker writes are far below PIPE_BUF, so lines always arrive intact.
+void KernelTracer::annotation_loop() {
+    // Hold our own write end so the read end never reports EOF between
+    // transient omnistat-annotate writers; poll then blocks cleanly until a
+    // marker arrives instead of spinning on POLLHUP
+    int guard_fd = open(annotation_fifo_path_.c_str(), O_WRONLY | O_NONBLOCK);
+
+    std::string pending;
+    char chunk[512];
+
+    while (!stop_requested_.load()) {
+        // The timeout paces shutdown checks; markers wake the poll directly
+        struct pollfd pfd = {annotation_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0 || (pfd.revents & POLLIN) == 0) {
+            continue;
+        }
+
+        ssize_t bytes = read(annotation_fd_, chunk, sizeof(chunk));
+        if (bytes <= 0) {
+            continue;
+        }
+        pending.append(chunk, static_cast<size_t>(bytes));
+
+        size_t newline;
+        while ((newline = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+
+            // Unrecognized markers are ignored
+            if (line.rfind("start ", 0) == 0) {
+                open_window(line.substr(6));
+            } else if (line == "stop") {
+                close_window();
+            }
+        }
+    }
+
+    if (guard_fd >= 0) {
+        close(guard_fd);
+    }
+}
+
+void KernelTracer::open_window(std::string label) {
+    close_window();
+
+    std::lock_guard<std::mutex> lock(window_mutex_);
+    window_label_ = std::move(label);
+    window_start_ns_ = boottime_ns();
+}
+
+void KernelTracer::close_window() {
+    // Push buffered dispatches through the callback before snapshotting the
+    // table. Records still draining when the snapshot is taken land in the
+    // next window — the same boundary slop the periodic flush accepts.
+    for (auto buffer : buffers) {
+        auto flush_status = rocprofiler_flush_buffer(buffer);
+        if (flush_status != ROCPROFILER_STATUS_SUCCESS &&
+            flush_status != ROCPROFILER_STATUS_ERROR_BUFFER_BUSY) {
+            std::cerr << "Warning: window buffer flush failed with status " << flush_status
+                      << std::endl;
+        }
+    }
+
+    std::string label;
+    uint64_t start_ns = 0;
+    std::map<std::pair<uint32_t, uint64_t>, KernelStats> table;
+    {
+        std::lock_guard<std::mutex> lock(window_mutex_);
+        if (window_label_.empty()) {
+            return;
+        }
+        label.swap(window_label_);
+        start_ns = window_start_ns_;
+        table.swap(window_table_);
+    }
+
+    // One compact payload per closed window: the phase is aggregated at the
+    // source instead of shipping its raw records for re-scanning. Window
+    // dispatches already count toward flush statistics through the raw or
+    // aggregate path, so the roll-up reports zero records of its own.
+    std::string data = acquire_buffer();
+    fmt::format_to(std::back_inserter(data), "{{\"client\":{},\"window\":{{\"annotation\":\"",
+                   client_id_);
+    append_json_escaped(data, label);
+    fmt::format_to(std::back_inserter(data), "\",\"start_ns\":{},\"end_ns\":{},\"kernels\":",
+                   start_ns, boottime_ns());
+    if (table.empty()) {
+        data.append("[]");
+    } else {
+        append_aggregate_entries(data, table);
+    }
+    data.append("}}");
+
+    enqueue(std::move(data), 0, true);
+}
+
+FlushResult KernelTracer::post(std::string_view data, const std::string& url,
+                               struct curl_slist* headers) {
+    // The easy handle and the response/compression scratch buffers are
+    // shared between the sender thread and the periodic thread's spill
+    // replay; serialize their use
+    std::lock_guard<std::mutex> curl_lock(curl_mutex_);
+
+#if defined(HAS_ZSTD)
+    if (zstd_cctx_ != nullptr) {
+        size_t bound = ZSTD_compressBound(data.size());
+        zstd_buffer_.resize(bound);
+        size_t written =
+            ZSTD_compress2(zstd_cctx_, zstd_buffer_.data(), bound, data.data(), data.size());
+        if (ZSTD_isError(written)) {
+            // The headers promise zstd content; never send the raw payload
+            return FlushResult::Failed;
+        }
+        zstd_buffer_.resize(written);
+        data = zstd_buffer_;
+    }
+#endif
+
+    curl_easy_setopt(curl_handle_, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl_handle_, CURLOPT_HTTPHEADER, headers);
     curl_easy_setopt(curl_handle_, CURLOPT_POST, 1L);
     curl_easy_setopt(curl_handle_, CURLOPT_POSTFIELDSIZE, static_cast<long>(data.size()));
     curl_easy_setopt(curl_handle_, CURLOPT_POSTFIELDS, data.data());
 
-    std::string response_buffer;
-    curl_easy_setopt(curl_handle_, CURLOPT_WRITEDATA, &response_buffer);
+    response_buffer_.clear();
+    curl_easy_setopt(curl_handle_, CURLOPT_WRITEDATA, &response_buffer_);
 
-    CURLcode res = curl_easy_perform(curl_handle_);
+    // Retry transport errors and server-side failures with exponential
+    // backoff; the Python server cycling workers shows up as exactly these.
+    // Client-side rejections (4xx) are never going to succeed on retry.
+    for (uint64_t attempt = 0; attempt <= flush_retries_; ++attempt) {
+        if (attempt > 0) {
+            if (stop_requested_.load()) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(RETRY_BACKOFF_MS << (attempt - 1)));
+        }
+
+        const auto attempt_start = std::chrono::steady_clock::now();
+        CURLcode res = curl_easy_perform(curl_handle_);
+        record_post_latency(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - attempt_start)
+                                .count());
+
+        if (res != CURLE_OK) {
+            continue;
+        }
 
-    bool success = false;
-    if (res == CURLE_OK) {
         long http_code = 0;
         curl_easy_getinfo(curl_handle_, CURLINFO_RESPONSE_CODE, &http_code);
-        success = http_code < 400;
+        if (http_code < 400) {
+            return FlushResult::Success;
+        }
+        if (http_code < 500) {
+            return FlushResult::Rejected;
+        }
     }
 
-    record_flush_stats(num_records, !success);
-    return success;
+    return FlushResult::Failed;
+}
+
+void KernelTracer::queue_dictionary_entry(uint64_t kernel_id, const std::string& kernel_name) {
+    std::lock_guard<std::mutex> lock(dict_mutex_);
+    pending_dict_.emplace_back(kernel_id, kernel_name);
+}
+
+bool KernelTracer::send_pending_dictionary() {
+    std::vector<std::pair<uint64_t, std::string>> entries;
+    {
+        std::lock_guard<std::mutex> lock(dict_mutex_);
+        entries.swap(pending_dict_);
+    }
+
+    if (entries.empty()) {
+        return true;
+    }
+
+    std::string data;
+    fmt::format_to(std::back_inserter(data), "{{\"client\":{},\"kernels\":[", client_id_);
+    for (const auto& [kernel_id, kernel_name] : entries) {
+        fmt::format_to(std::back_inserter(data), "[{},\"", kernel_id);
+        append_json_escaped(data, kernel_name);
+        data.append("\"],");
+    }
+    data.back() = ']';
+    data.push_back('}');
+
+    if (post(data, dict_url_, json_headers_) != FlushResult::Success) {
+        // Re-queue so the pairs are retried on the next flush
+        std::lock_guard<std::mutex> lock(dict_mutex_);
+        pending_dict_.insert(pending_dict_.begin(), std::make_move_iterator(entries.begin()),
+                             std::make_move_iterator(entries.end()));
+        return false;
+    }
+
+    return true;
+}
+
+std::chrono::seconds KernelTracer::next_flush_interval() {
+    if (target_payload_bytes_ == 0) {
+        return periodic_flush_interval_;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto bytes = total_bytes_.load(std::memory_order_relaxed);
+    auto elapsed = std::chrono::duration<double>(now - adapt_time_).count();
+    auto delta = bytes - adapt_bytes_;
+
+    adapt_time_ = now;
+    adapt_bytes_ = bytes;
+
+    if (elapsed <= 0.0 || delta == 0) {
+        // Idle: back off to the maximum so sleeping endpoints stay asleep
+        return periodic_flush_interval_;
+    }
+
+    // Interval that would produce a target-sized payload at the observed
+    // byte rate, clamped between the floor and the configured maximum
+    double target_seconds = static_cast<double>(target_payload_bytes_) *
+                            (elapsed / static_cast<double>(delta));
+    target_seconds = std::clamp(target_seconds, static_cast<double>(MIN_FLUSH_INTERVAL_SECONDS),
+                                static_cast<double>(periodic_flush_interval_.count()));
+    return std::chrono::seconds(static_cast<uint64_t>(target_seconds));
 }
 
 void KernelTracer::periodic_flush() {
+    adapt_time_ = std::chrono::steady_clock::now();
+    auto interval = periodic_flush_interval_;
+
     while (true) {
         std::unique_lock<std::mutex> lock(periodic_mutex_);
 
         // wait_for returns false on timeout, true if predicate returns true
-        bool stop_signaled = periodic_cv_.wait_for(lock, periodic_flush_interval_,
-                                                   [this] { return stop_requested_.load(); });
+        bool stop_signaled =
+            periodic_cv_.wait_for(lock, interval, [this] { return stop_requested_.load(); });
         if (stop_signaled) {
             break;
         }
 
+        interval = next_flush_interval();
+
         auto now = std::chrono::steady_clock::now();
         auto last = std::chrono::steady_clock::time_point(
             std::chrono::steady_clock::duration(last_flush_time_.load()));
-        if ((now - last) < periodic_flush_interval_) {
+        if ((now - last) < interval) {
             continue;
         }
 
         // Timeout occurred, perform periodic flush
-        auto flush_status = rocprofiler_flush_buffer(buffer);
+        for (auto buffer : buffers) {
+            auto flush_status = rocprofiler_flush_buffer(buffer);
 
-        // Ignore BUFFER_BUSY errors as the buffer might be in use
-        if (flush_status != ROCPROFILER_STATUS_SUCCESS &&
-            flush_status != ROCPROFILER_STATUS_ERROR_BUFFER_BUSY) {
-            std::cerr << "Warning: periodic buffer flush failed with status " << flush_status
-                      << std::endl;
+            // Ignore BUFFER_BUSY errors as the buffer might be in use
+            if (flush_status != ROCPROFILER_STATUS_SUCCESS &&
+                flush_status != ROCPROFILER_STATUS_ERROR_BUFFER_BUSY) {
+                std::cerr << "Warning: periodic buffer flush failed with status " << flush_status
+                          << std::endl;
+            }
+        }
+
+        // In aggregation mode the buffer callback only folds records into
+        // the table; send the accumulated interval data out here. Records
+        // still draining from the buffer flush above simply land in the next
+        // interval.
+        if (aggregate_enabled) {
+            flush_aggregate();
+        }
+
+        replay_spilled();
+
+        // Push the live health counters alongside each periodic cycle so
+        // tracer overhead and drops are observable while the job runs
+        if (!file_sink_enabled()) {
+            send_health();
         }
     }
 }
@@ -24,27 +24,127 @@
 
 #pragma once
 
+#include "spill_ring.hpp"
+#include "trace_file.hpp"
+#include "trace_format.hpp"
+
 #include <rocprofiler-sdk/rocprofiler.h>
 
 #include <curl/curl.h>
 
+// Forward declaration so the header doesn't require zstd.h; only the
+// translation unit needs the real definition (and only when HAS_ZSTD is set)
+struct ZSTD_CCtx_s;
+
+#include <array>
 #include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <shared_mutex>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace omnistat {
 
-// Default periodic flush interval in seconds
+// Default periodic flush interval in seconds; with adaptive scheduling this
+// is the ceiling the interval backs off to when idle
 constexpr uint64_t DEFAULT_FLUSH_INTERVAL_SECONDS = 13;
 
+// Shortest interval the adaptive flush scheduler will drop to under load
+constexpr uint64_t MIN_FLUSH_INTERVAL_SECONDS = 1;
+
+// Default payload size the adaptive scheduler aims for when picking the next
+// flush interval from the observed record rate
+constexpr uint64_t DEFAULT_TARGET_PAYLOAD_BYTES = 65536;
+
 // Default buffer size in bytes
 constexpr uint64_t DEFAULT_BUFFER_SIZE_BYTES = 262144;
 
 // Endpoint port for sending kernel trace data
 constexpr uint64_t DEFAULT_TRACE_ENDPOINT_PORT = 8001;
 
+// Default maximum number of serialized payloads queued for the sender thread
+constexpr uint64_t DEFAULT_SEND_QUEUE_DEPTH = 8;
+
+// Default per-request timeout for HTTP POSTs in milliseconds; bounds how long
+// a hung endpoint can hold up the thread performing a flush
+constexpr uint64_t DEFAULT_CURL_TIMEOUT_MS = 5000;
+
+// Default number of retries for failed POSTs, with exponential backoff
+// starting at RETRY_BACKOFF_MS
+constexpr uint64_t DEFAULT_FLUSH_RETRIES = 2;
+constexpr uint64_t RETRY_BACKOFF_MS = 250;
+
+// Default capacity of the spill ring file for failed flushes
+constexpr uint64_t DEFAULT_SPILL_SIZE_BYTES = 16777216;
+
+// Number of log-scale buckets in per-kernel duration histograms; bucket b
+// counts dispatches with durations in [2^(b-1), 2^b) nanoseconds
+constexpr size_t NUM_DURATION_BUCKETS = 32;
+
+// Number of log-scale buckets in the POST latency histogram; bucket b counts
+// attempts that took [2^(b-1), 2^b) microseconds, so 24 buckets cover up to
+// ~16 seconds — beyond any configurable curl timeout
+constexpr size_t NUM_LATENCY_BUCKETS = 24;
+
+// Upper bound on serialization buffers retained in the flush arena; enough
+// for a full send queue plus in-flight buffers on every callback thread,
+// while still releasing memory after a transient burst
+constexpr size_t MAX_POOLED_FLUSH_BUFFERS = 16;
+
+// Kernel-ID → name map safe for concurrent registration/unregistration from
+// the code object callback while buffer callback threads look names up.
+// Kernel IDs are small integers, so IDs below the dense-table capacity get
+// wait-free lookups via an atomic pointer slot; larger IDs fall back to a
+// sharded map under per-shard reader/writer locks. Stored pointers reference
+// entries of the demangle cache, which live for the process lifetime, so a
+// name obtained just before a concurrent unload never dangles.
+class KernelNameMap {
+  public:
+    KernelNameMap() : dense_(DENSE_CAPACITY) {}
+
+    void insert(uint64_t kernel_id, const std::string* name);
+    void erase(uint64_t kernel_id);
+
+    // Returns nullptr when the kernel is unknown (e.g. unloaded mid-flush)
+    const std::string* find(uint64_t kernel_id) const;
+
+  private:
+    static constexpr size_t DENSE_CAPACITY = 65536;
+    static constexpr size_t NUM_SHARDS = 16;
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<uint64_t, const std::string*> map;
+    };
+
+    std::vector<std::atomic<const std::string*>> dense_;
+    std::array<Shard, NUM_SHARDS> shards_;
+};
+
+// Outcome of a flush attempt. Rejected marks a definitive client-side
+// refusal (HTTP 4xx) that neither retrying nor spilling can fix, as opposed
+// to transport errors and server-side failures that may clear up.
+enum class FlushResult {
+    Success,
+    Failed,
+    Rejected,
+};
+
+// Per-kernel dispatch statistics accumulated in aggregation mode
+struct KernelStats {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t min_ns = UINT64_MAX;
+    uint64_t max_ns = 0;
+    std::array<uint32_t, NUM_DURATION_BUCKETS> buckets = {};
+};
+
 class KernelTracer {
   public:
     KernelTracer();
@@ -54,11 +154,84 @@ class KernelTracer {
     int initialize();
 
     // Sends kernel trace data to the HTTP endpoint and records flush stats.
-    bool flush(std::string_view data, size_t num_records);
+    // Payloads are sent with the configured trace format headers unless
+    // as_json is set (used for dictionary and aggregate payloads).
+    FlushResult flush(std::string_view data, size_t num_records, bool as_json = false);
+
+    // Hands a serialized payload to the sender thread so buffer callbacks
+    // don't block on the HTTP POST. Falls back to a synchronous flush when
+    // the send queue is disabled (OMNISTAT_TRACE_QUEUE_DEPTH=0). When the
+    // queue is full the oldest queued payload is dropped and counted.
+    void enqueue(std::string&& data, size_t num_records, bool as_json = false);
+
+    // Fold one dispatch into the per-kernel aggregation table
+    void accumulate(uint32_t gpu_id, uint64_t kernel_id, uint64_t duration_ns);
+
+    // Fold one dispatch into the current annotation window's per-kernel
+    // table; dispatches outside any open window are not rolled up
+    void accumulate_window(uint32_t gpu_id, uint64_t kernel_id, uint64_t duration_ns);
+
+    // Decide whether a dispatch is kept under statistical sampling (keep 1
+    // of OMNISTAT_TRACE_SAMPLING dispatches); always true when disabled
+    bool sample_dispatch();
+
+    // Accumulate records discarded by the lossy buffer policy, as reported
+    // via the drop_count argument of the buffer callback
+    void record_buffer_drops(uint64_t drop_count);
+
+    // Flush arena: serialization buffers recycled across flush cycles so
+    // steady-state tracing stays off the shared application heap.
+    // acquire_buffer() hands out an empty string that retains the capacity
+    // of its previous use; recycle it once its payload has been posted,
+    // written to the trace file, or dropped.
+    std::string acquire_buffer();
+    void recycle_buffer(std::string&& buffer);
+
+    // Add payload serialization time from a buffer callback to the live
+    // health counters
+    void record_serialization(uint64_t elapsed_ns);
 
-    // Members used directly by the rocprofiler-sdk tool callbacks
-    rocprofiler_buffer_id_t buffer = {};
-    std::unordered_map<rocprofiler_kernel_id_t, std::string> kernels = {};
+    // Serialize the live health counters — record/flush/drop totals,
+    // serialization and POST time, queue depth, POST latency histogram — as
+    // a JSON payload for the endpoint's /kernel_trace/health route
+    std::string build_health_payload();
+
+    // Serialize and enqueue the current aggregation table, resetting it
+    void flush_aggregate();
+
+    // Demangle a kernel symbol name, caching the result so each unique
+    // mangled name is demangled exactly once per process
+    const std::string& demangle(const char* mangled_name);
+
+    // Queue a (kernel_id, name) pair for the next dictionary sync with the
+    // endpoint. Used when dictionary mode is enabled so dispatch records can
+    // reference kernels by ID instead of embedding the name.
+    void queue_dictionary_entry(uint64_t kernel_id, const std::string& kernel_name);
+
+    // Identifies this process to the endpoint, scoping kernel dictionary IDs
+    uint32_t client_id() const { return client_id_; }
+
+    // Whether dispatch records go to a local trace file instead of the HTTP
+    // endpoint (OMNISTAT_TRACE_FILE); selected for endpoint-less runs
+    bool file_sink_enabled() const { return trace_file_ != nullptr; }
+
+    // Append one serialized binary payload as an indexed block of the trace
+    // file, tagged with the time range its dispatches cover
+    void write_block(std::string_view data, size_t num_records, uint64_t min_timestamp,
+                     uint64_t max_timestamp);
+
+    // Members used directly by the rocprofiler-sdk tool callbacks. A single
+    // buffer serves all agents by default; in per-agent mode there is one
+    // buffer (and callback thread) per GPU, with buffer_agents mapping each
+    // buffer handle to the agent it is responsible for.
+    std::vector<rocprofiler_buffer_id_t> buffers = {};
+    std::unordered_map<uint64_t, uint64_t> buffer_agents = {};
+    TraceFormat format = TraceFormat::Json;
+    bool dictionary_enabled = false;
+    bool aggregate_enabled = false;
+    bool per_agent_enabled = false;
+    bool windows_enabled = false;
+    KernelNameMap kernels;
     std::unordered_map<uint64_t, uint32_t> agents = {};
 
   private:
@@ -66,15 +239,61 @@ class KernelTracer {
     // flushing triggered by full buffers
     void periodic_flush();
 
+    // Pick the next flush interval from the payload byte rate observed since
+    // the previous wake-up, aiming for target-sized payloads: shorter under
+    // heavy dispatch load, backing off to the configured maximum when idle
+    std::chrono::seconds next_flush_interval();
+
+    // Thread draining the send queue; serialization in the buffer callback is
+    // decoupled from the libcurl POST so a slow endpoint can't back-pressure
+    // application kernel dispatches through the rocprofiler buffer
+    void sender_loop();
+
+    // Set up curl, endpoint URLs, headers, compression, and the spill ring;
+    // skipped when the trace file sink is active
+    int initialize_endpoint();
+
+    // Thread reading annotation window markers from the fifo named by
+    // OMNISTAT_TRACE_ANNOTATIONS; markers open and close roll-up windows
+    void annotation_loop();
+
+    // Window transitions; both flush the rocprofiler buffers first so
+    // in-flight dispatches are attributed to the window they ran in
+    void open_window(std::string label);
+    void close_window();
+
+    // Serialize a per-kernel stats table as JSON aggregate entries of the
+    // form [gpu_id, kernel, count, total_ns, min_ns, max_ns, [buckets]],
+    // shared between interval aggregation and window roll-ups
+    size_t append_aggregate_entries(std::string& data,
+                                    const std::map<std::pair<uint32_t, uint64_t>, KernelStats>& table);
+
     // Internal helpers for flush()
+    FlushResult post(std::string_view data, const std::string& url, struct curl_slist* headers);
+    bool send_pending_dictionary();
+    void record_post_latency(uint64_t elapsed_ns);
+    void send_health();
     void record_flush_time();
     void record_flush_stats(size_t num_records, bool failed);
 
+    // Spill a payload after a failed flush, and replay spilled payloads in
+    // order once the endpoint recovers
+    void spill_payload(std::string_view data, size_t num_records, bool as_json);
+    void replay_spilled();
+
     rocprofiler_context_id_t context_ = {.handle = 0};
 
+    // Additional contexts hosting the per-agent buffers in per-agent mode
+    std::vector<rocprofiler_context_id_t> agent_contexts_;
+
     const std::chrono::seconds periodic_flush_interval_;
+    const uint64_t target_payload_bytes_;
     const uint64_t buffer_size_bytes_;
     const uint64_t endpoint_port_;
+    const uint64_t send_queue_depth_;
+    const uint64_t curl_timeout_ms_;
+    const uint64_t flush_retries_;
+    const uint64_t sampling_rate_;
     const bool log_enabled_;
 
     std::thread periodic_thread_;
@@ -83,14 +302,114 @@ class KernelTracer {
     std::atomic<bool> stop_requested_{false};
     std::atomic<std::chrono::steady_clock::rep> last_flush_time_;
 
+    // Adaptive scheduling state; the byte counter is shared with the flush
+    // path, the rest is only touched by the periodic thread
+    std::atomic<uint64_t> total_bytes_{0};
+    uint64_t adapt_bytes_ = 0;
+    std::chrono::steady_clock::time_point adapt_time_;
+
+    // Bounded queue of serialized payloads awaiting the sender thread
+    struct FlushPayload {
+        std::string data;
+        size_t num_records;
+        bool as_json;
+    };
+
+    std::thread sender_thread_;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<FlushPayload> send_queue_;
+    bool sender_stop_requested_ = false;
+
     // Counters for summary statistics
     std::atomic<uint64_t> total_flushes_{0};
     std::atomic<uint64_t> total_records_{0};
     std::atomic<uint64_t> failed_flushes_{0};
     std::atomic<uint64_t> failed_records_{0};
+    std::atomic<uint64_t> overflow_flushes_{0};
+    std::atomic<uint64_t> overflow_records_{0};
+
+    // Sampling state: running dispatch counter for 1-of-N decimation, plus
+    // counters for decimated records and lossy-buffer drops
+    std::atomic<uint64_t> sample_counter_{0};
+    std::atomic<uint64_t> sampled_out_records_{0};
+    std::atomic<uint64_t> buffer_dropped_records_{0};
+
+    // Live health counters pushed to the endpoint every periodic interval,
+    // so tracer overhead and drops are visible during the job instead of
+    // only in the exit summary; all updated with relaxed atomics on the
+    // serialization and POST paths
+    std::atomic<uint64_t> serialize_ns_{0};
+    std::atomic<uint64_t> post_ns_{0};
+    std::atomic<uint64_t> post_attempts_{0};
+    std::array<std::atomic<uint32_t>, NUM_LATENCY_BUCKETS> post_latency_buckets_ = {};
+
+    // Node-local spill ring for payloads that failed to flush; appended to
+    // by the sender thread, replayed by the periodic thread
+    std::mutex spill_mutex_;
+    std::unique_ptr<SpillRing> spill_ring_;
+
+    // Local trace file sink for endpoint-less runs; when set, the HTTP
+    // machinery (curl, sender thread, spill ring) is never brought up
+    std::string trace_file_path_;
+    std::unique_ptr<TraceFileSink> trace_file_;
+
+    // Aggregation table keyed by (gpu_id, kernel_id), populated by the
+    // buffer callback and drained by the periodic flush thread
+    std::mutex aggregate_mutex_;
+    std::map<std::pair<uint32_t, uint64_t>, KernelStats> aggregate_;
+
+    // Annotation window state: the current window's label, start timestamp
+    // (CLOCK_BOOTTIME, matching dispatch timestamps), and per-kernel table.
+    // An empty label means no window is open. Populated by the buffer
+    // callback, transitioned by the annotation thread.
+    std::mutex window_mutex_;
+    std::string window_label_;
+    uint64_t window_start_ns_ = 0;
+    std::map<std::pair<uint32_t, uint64_t>, KernelStats> window_table_;
 
-    // libcurl handle for sending trace data
+    std::thread annotation_thread_;
+    std::string annotation_fifo_path_;
+    int annotation_fd_ = -1;
+
+    // Flush arena: pooled serialization buffers, bounded by
+    // MAX_POOLED_FLUSH_BUFFERS and grown high-water-mark style
+    std::mutex buffer_pool_mutex_;
+    std::vector<std::string> buffer_pool_;
+
+    // Demangled names cached by mangled symbol name; entries survive code
+    // object unloads so reloads don't pay for demangling again, and their
+    // process-lifetime stability is what lets KernelNameMap hand out plain
+    // pointers. Guarded against concurrent code object callbacks.
+    std::mutex demangle_mutex_;
+    std::unordered_map<std::string, std::string> demangle_cache_;
+
+    // Dictionary entries queued for the next sync with the endpoint
+    std::mutex dict_mutex_;
+    std::vector<std::pair<uint64_t, std::string>> pending_dict_;
+
+    uint32_t client_id_ = 0;
+
+    // Long-lived zstd compression context reused across flushes when payload
+    // compression is enabled; null when disabled or built without zstd
+    ZSTD_CCtx_s* zstd_cctx_ = nullptr;
+
+    // libcurl handle and per-payload-type state for sending trace data. The
+    // handle is long-lived so connections are pooled and kept alive across
+    // flushes; the mutex serializes its use between the sender thread and
+    // the periodic thread's spill replay.
+    std::mutex curl_mutex_;
     CURL* curl_handle_ = nullptr;
+
+    // Response and compression scratch reused across POSTs; shared state of
+    // post(), guarded by curl_mutex_ like the handle itself
+    std::string response_buffer_;
+    std::string zstd_buffer_;
+    std::string trace_url_;
+    std::string dict_url_;
+    std::string health_url_;
+    struct curl_slist* trace_headers_ = nullptr;
+    struct curl_slist* json_headers_ = nullptr;
 };
 
 } // namespace omnistat
@@ -0,0 +1,114 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2023 - 2026 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+#include "shm_metrics.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace omnistat {
+
+ShmMetricsSegment::~ShmMetricsSegment() {
+    if (header_) {
+        munmap(static_cast<void*>(header_), mapped_size_);
+    }
+}
+
+void ShmMetricsSegment::create(const std::string& path,
+                               const std::vector<std::vector<std::string>>& names) {
+    size_t num_slots = 0;
+    device_offsets_.clear();
+    device_counts_.clear();
+    for (const auto& device_names : names) {
+        device_offsets_.push_back(num_slots);
+        device_counts_.push_back(device_names.size());
+        num_slots += device_names.size();
+    }
+
+    mapped_size_ = sizeof(ShmMetricsHeader) + num_slots * sizeof(ShmMetricSlot);
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to create shared metrics segment: " + path);
+    }
+    if (ftruncate(fd, mapped_size_) != 0) {
+        close(fd);
+        throw std::runtime_error("Unable to size shared metrics segment: " + path);
+    }
+
+    void* mapping = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Unable to map shared metrics segment: " + path);
+    }
+
+    std::memset(mapping, 0, mapped_size_);
+    header_ = static_cast<ShmMetricsHeader*>(mapping);
+    slots_ = reinterpret_cast<ShmMetricSlot*>(header_ + 1);
+
+    size_t slot = 0;
+    for (size_t device = 0; device < names.size(); device++) {
+        for (const auto& name : names[device]) {
+            slots_[slot].seq.store(0, std::memory_order_relaxed);
+            slots_[slot].value = 0.0;
+            slots_[slot].device = static_cast<uint32_t>(device);
+            std::strncpy(slots_[slot].name, name.c_str(), SHM_METRIC_NAME_SIZE - 1);
+            slot++;
+        }
+    }
+
+    header_->version = SHM_METRICS_VERSION;
+    header_->num_slots = static_cast<uint32_t>(num_slots);
+    header_->num_devices = static_cast<uint32_t>(names.size());
+
+    // Publish the magic last so a reader mapping mid-create never sees a
+    // valid header in front of half-initialized slots
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = SHM_METRICS_MAGIC;
+}
+
+void ShmMetricsSegment::publish(size_t device, const std::vector<double>& values) {
+    if (!header_ || device >= device_offsets_.size()) {
+        return;
+    }
+
+    ShmMetricSlot* base = slots_ + device_offsets_[device];
+    size_t count = std::min(values.size(), device_counts_[device]);
+
+    for (size_t i = 0; i < count; i++) {
+        auto& slot = base[i];
+        uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+        slot.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.value = values[i];
+        slot.seq.store(seq + 2, std::memory_order_release);
+    }
+}
+
+} // namespace omnistat
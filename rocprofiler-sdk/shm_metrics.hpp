@@ -0,0 +1,89 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2023 - 2026 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace omnistat {
+
+// Fixed-layout shared-memory segment for publishing the latest counter
+// values. Each metric occupies its own cache line so concurrent writers for
+// different devices never share one, and each slot carries a per-metric
+// sequence counter (odd = mid-write) so readers — other threads or other
+// processes mapping the same file — copy values without locks. The layout
+// never changes after create(), making a read a handful of loads per metric.
+
+inline constexpr uint32_t SHM_METRICS_MAGIC = 0x4d534d4f; // "OMSM" little-endian
+inline constexpr uint32_t SHM_METRICS_VERSION = 1;
+inline constexpr size_t SHM_METRIC_NAME_SIZE = 40;
+
+struct alignas(64) ShmMetricsHeader {
+    uint32_t magic; // written last during create() so readers see a complete layout
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t num_devices;
+};
+
+struct alignas(64) ShmMetricSlot {
+    std::atomic<uint64_t> seq; // even = stable, odd = mid-write
+    double value;
+    uint32_t device;
+    char name[SHM_METRIC_NAME_SIZE]; // NUL-terminated, truncated if longer; written once
+};
+
+static_assert(sizeof(ShmMetricsHeader) == 64, "header must be one cache line");
+static_assert(sizeof(ShmMetricSlot) == 64, "slots must be one cache line");
+
+class ShmMetricsSegment {
+  public:
+    ShmMetricsSegment() = default;
+    ~ShmMetricsSegment();
+
+    ShmMetricsSegment(const ShmMetricsSegment&) = delete;
+    ShmMetricsSegment& operator=(const ShmMetricsSegment&) = delete;
+
+    // Create (truncating any previous segment) and map the file at path,
+    // sized for the given metric names of each device; throws on I/O errors.
+    // A path under /dev/shm keeps the segment off persistent storage.
+    void create(const std::string& path, const std::vector<std::vector<std::string>>& names);
+
+    // Publish the latest values of one device's metrics, in the order their
+    // names were passed to create(); extra values are ignored
+    void publish(size_t device, const std::vector<double>& values);
+
+    bool enabled() const { return header_ != nullptr; }
+
+  private:
+    ShmMetricsHeader* header_ = nullptr;
+    ShmMetricSlot* slots_ = nullptr;
+    std::vector<size_t> device_offsets_;
+    std::vector<size_t> device_counts_;
+    size_t mapped_size_ = 0;
+};
+
+} // namespace omnistat
@@ -0,0 +1,176 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2025 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+#include "spill_ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace omnistat {
+
+// The header occupies one page so the data region stays page-aligned
+constexpr uint64_t HEADER_SIZE = 4096;
+constexpr uint32_t SPILL_VERSION = 1;
+
+SpillRing::SpillRing(const std::string& path, uint64_t capacity_bytes) : capacity_(capacity_bytes) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Omnistat: failed to open spill file " << path << std::endl;
+        return;
+    }
+
+    uint64_t file_size = HEADER_SIZE + capacity_;
+    if (ftruncate(fd_, static_cast<off_t>(file_size)) != 0) {
+        std::cerr << "Omnistat: failed to size spill file " << path << std::endl;
+        close(fd_);
+        fd_ = -1;
+        return;
+    }
+
+    void* mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Omnistat: failed to map spill file " << path << std::endl;
+        close(fd_);
+        fd_ = -1;
+        return;
+    }
+
+    header_ = static_cast<Header*>(mapping);
+    data_ = static_cast<uint8_t*>(mapping) + HEADER_SIZE;
+
+    // Resume an existing ring with a matching layout so payloads spilled by
+    // a previous run can be replayed; otherwise (re)initialize
+    if (std::memcmp(header_->magic, "OMSP", 4) != 0 || header_->version != SPILL_VERSION ||
+        header_->capacity != capacity_ || header_->tail - header_->head > capacity_) {
+        std::memcpy(header_->magic, "OMSP", 4);
+        header_->version = SPILL_VERSION;
+        header_->capacity = capacity_;
+        header_->head = 0;
+        header_->tail = 0;
+    }
+}
+
+SpillRing::~SpillRing() {
+    if (header_ != nullptr) {
+        munmap(header_, HEADER_SIZE + capacity_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool SpillRing::empty() const {
+    return !valid() || header_->head == header_->tail;
+}
+
+void SpillRing::write_bytes(uint64_t offset, const void* src, uint64_t size) {
+    uint64_t pos = offset % capacity_;
+    uint64_t first = std::min(size, capacity_ - pos);
+    std::memcpy(data_ + pos, src, first);
+    if (first < size) {
+        std::memcpy(data_, static_cast<const uint8_t*>(src) + first, size - first);
+    }
+}
+
+void SpillRing::read_bytes(uint64_t offset, void* dst, uint64_t size) const {
+    uint64_t pos = offset % capacity_;
+    uint64_t first = std::min(size, capacity_ - pos);
+    std::memcpy(dst, data_ + pos, first);
+    if (first < size) {
+        std::memcpy(static_cast<uint8_t*>(dst) + first, data_, size - first);
+    }
+}
+
+bool SpillRing::read_entry(EntryHeader& entry) {
+    read_bytes(header_->head, &entry, sizeof(entry));
+
+    // Entries of a resumed ring cannot be trusted: an unclean shutdown can
+    // tear the file, persisting the tail update but not the entry bytes, so
+    // the descriptor at head may be garbage. A size larger than the bytes
+    // actually stored would drive reads past the mapping and push head past
+    // tail; reset the ring to empty instead, mirroring how the constructor
+    // reinitializes on a bad header.
+    if (sizeof(entry) + entry.size > header_->tail - header_->head) {
+        header_->head = header_->tail;
+        return false;
+    }
+    return true;
+}
+
+void SpillRing::drop_oldest() {
+    EntryHeader entry;
+    if (read_entry(entry)) {
+        header_->head += sizeof(entry) + entry.size;
+    }
+}
+
+void SpillRing::append(std::string_view data, uint32_t num_records, bool as_json) {
+    if (!valid()) {
+        return;
+    }
+
+    uint64_t needed = sizeof(EntryHeader) + data.size();
+    if (needed > capacity_) {
+        return;
+    }
+
+    while (capacity_ - (header_->tail - header_->head) < needed) {
+        drop_oldest();
+    }
+
+    EntryHeader entry = {static_cast<uint32_t>(data.size()), num_records, as_json ? 1u : 0u, 0};
+    write_bytes(header_->tail, &entry, sizeof(entry));
+    write_bytes(header_->tail + sizeof(entry), data.data(), data.size());
+    header_->tail += needed;
+}
+
+bool SpillRing::peek(std::string& data, uint32_t& num_records, bool& as_json) {
+    if (empty()) {
+        return false;
+    }
+
+    EntryHeader entry;
+    if (!read_entry(entry)) {
+        return false;
+    }
+
+    data.resize(entry.size);
+    read_bytes(header_->head + sizeof(entry), data.data(), entry.size);
+    num_records = entry.num_records;
+    as_json = entry.as_json != 0;
+    return true;
+}
+
+void SpillRing::pop() {
+    if (!empty()) {
+        drop_oldest();
+    }
+}
+
+} // namespace omnistat
@@ -0,0 +1,105 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2025 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace omnistat {
+
+// Bounded memory-mapped ring file used to spill serialized flush payloads
+// when the endpoint is unreachable, so records survive collector restarts
+// instead of being dropped. Appends are sequential mmap writes; no fsync is
+// performed, durability is best-effort across process crashes.
+//
+// The file starts with a header page holding monotonically increasing head
+// and tail byte offsets, followed by a fixed-capacity data region addressed
+// modulo its size. Entries are a 16-byte descriptor plus the payload bytes
+// and wrap at byte granularity. When the ring is full the oldest entries are
+// dropped to make room, bounding disk usage.
+//
+// An existing file with a matching header is resumed, so payloads spilled by
+// a previous run of the same configuration are replayed once the endpoint
+// recovers.
+class SpillRing {
+  public:
+    SpillRing(const std::string& path, uint64_t capacity_bytes);
+    ~SpillRing();
+
+    SpillRing(const SpillRing&) = delete;
+    SpillRing& operator=(const SpillRing&) = delete;
+
+    // False when the backing file could not be created or mapped; all other
+    // operations are no-ops in that state
+    bool valid() const { return header_ != nullptr; }
+
+    bool empty() const;
+
+    // Append one payload, dropping the oldest entries on overflow. Payloads
+    // larger than the ring capacity are ignored.
+    void append(std::string_view data, uint32_t num_records, bool as_json);
+
+    // Copy the oldest entry without consuming it. Returns false when empty.
+    bool peek(std::string& data, uint32_t& num_records, bool& as_json);
+
+    // Consume the oldest entry (after a successful replay of a peeked entry)
+    void pop();
+
+  private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t capacity;
+        uint64_t head;
+        uint64_t tail;
+    };
+
+    struct EntryHeader {
+        uint32_t size;
+        uint32_t num_records;
+        uint32_t as_json;
+        uint32_t reserved;
+    };
+
+    // Copy bytes to/from the data region at a monotonic offset, handling
+    // wraparound at the region boundary
+    void write_bytes(uint64_t offset, const void* src, uint64_t size);
+    void read_bytes(uint64_t offset, void* dst, uint64_t size) const;
+
+    // Read and validate the entry descriptor at head. Returns false and
+    // resets the ring to empty when the descriptor doesn't fit the stored
+    // bytes (a torn file from an unclean shutdown)
+    bool read_entry(EntryHeader& entry);
+
+    void drop_oldest();
+
+    Header* header_ = nullptr;
+    uint8_t* data_ = nullptr;
+    uint64_t capacity_ = 0;
+    int fd_ = -1;
+};
+
+} // namespace omnistat
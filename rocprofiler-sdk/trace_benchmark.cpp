@@ -0,0 +1,243 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2025 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+// Microbenchmark for the kernel trace serialization hot path. Feeds synthetic
+// dispatch records through the same trace_format routines used by the buffer
+// callback in kernel_tracer.cpp and reports records/sec and bytes/record for
+// each wire format, so encoding changes can be judged with data instead of
+// intuition. Not built by default; enable with -DBUILD_TRACE_BENCHMARK=ON.
+//
+// Usage: trace_benchmark [num_records] [mean_name_length] [iterations]
+
+#include "trace_format.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(HAS_STD_FORMAT)
+#include <format>
+namespace fmt = std;
+#else
+#include <fmt/core.h>
+#endif
+
+namespace {
+
+// Synthetic stand-in for the fields of
+// rocprofiler_buffer_tracing_kernel_dispatch_record_t that the serialization
+// path reads; using a plain struct keeps the benchmark free of SDK headers
+struct SyntheticDispatch {
+    uint32_t gpu_id;
+    uint64_t kernel_id;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+// Generate kernel names with lengths drawn from a geometric-ish distribution
+// around the requested mean. Real traces mix short HIP kernels with >700 byte
+// demangled template instantiations, so a spread matters more than the mean.
+std::vector<std::string> generate_names(size_t count, size_t mean_length, std::mt19937_64& rng) {
+    std::exponential_distribution<double> length_dist(1.0 / static_cast<double>(mean_length));
+    std::uniform_int_distribution<int> char_dist(0, 61);
+    constexpr const char* alphabet =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto length = std::max<size_t>(8, static_cast<size_t>(length_dist(rng)));
+        std::string name;
+        name.reserve(length);
+        for (size_t c = 0; c < length; ++c) {
+            name.push_back(alphabet[char_dist(rng)]);
+        }
+        names.push_back(std::move(name));
+    }
+    return names;
+}
+
+// Serialize one full payload the way full_buffer_callback does, returning the
+// payload size in bytes
+template <typename AppendRecord>
+size_t serialize_payload(const std::vector<SyntheticDispatch>& records, bool binary,
+                         bool kernel_ids, AppendRecord&& append_record) {
+    constexpr size_t max_bytes_per_record = 1024;
+
+    std::string data;
+    data.reserve(records.size() * max_bytes_per_record);
+
+    if (binary) {
+        uint8_t flags = kernel_ids ? omnistat::BINARY_FLAG_KERNEL_IDS : 0;
+        omnistat::append_binary_header(data, 0, flags, 12345);
+    } else if (kernel_ids) {
+        fmt::format_to(std::back_inserter(data), "{{\"client\":{},\"records\":[", 12345);
+    } else {
+        data.push_back('[');
+    }
+
+    for (const auto& record : records) {
+        append_record(data, record);
+    }
+
+    if (binary) {
+        omnistat::patch_binary_record_count(data, static_cast<uint32_t>(records.size()));
+    } else {
+        data.back() = ']';
+        if (kernel_ids) {
+            data.push_back('}');
+        }
+    }
+
+    return data.size();
+}
+
+template <typename AppendRecord>
+void run_benchmark(const char* label, const std::vector<SyntheticDispatch>& records,
+                   size_t iterations, bool binary, bool kernel_ids,
+                   AppendRecord&& append_record) {
+    // Warm-up pass so allocator and cache state match the steady state
+    size_t payload_bytes = serialize_payload(records, binary, kernel_ids, append_record);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        payload_bytes = serialize_payload(records, binary, kernel_ids, append_record);
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double records_per_sec = static_cast<double>(records.size() * iterations) / elapsed;
+    double bytes_per_record =
+        static_cast<double>(payload_bytes) / static_cast<double>(records.size());
+
+    std::cout << fmt::format("{:<16} {:>14.0f} records/sec {:>10.1f} bytes/record", label,
+                             records_per_sec, bytes_per_record)
+              << std::endl;
+}
+
+// Representative mangled names covering the common cases: plain C symbols,
+// simple templates, and the deeply nested instantiations ML frameworks emit
+constexpr const char* mangled_names[] = {
+    "hip_fill_kernel",
+    "_Z9axpy_implIfEvT_PKS0_PS0_i",
+    "_ZN7rocblas13gemm_batchedIfLi128ELi128ELi8EEEvPKT_S3_PS1_iiii",
+    "_ZN5eigen8internal15generic_productINS_6MatrixIfLin1ELin1ELi0ELin1ELin1EEES3_EEvRKT_RKT0_",
+};
+
+void run_demangle_benchmark(size_t iterations) {
+    // Mirrors KernelTracer::demangle: cache demangled names by mangled symbol
+    std::unordered_map<std::string, std::string> cache;
+
+    auto demangle = [&cache](const char* mangled) -> const std::string& {
+        auto it = cache.find(mangled);
+        if (it != cache.end()) {
+            return it->second;
+        }
+        int status = -1;
+        std::unique_ptr<char, void (*)(void*)> result(
+            abi::__cxa_demangle(mangled, nullptr, nullptr, &status), std::free);
+        std::string demangled = (status == 0) ? result.get() : mangled;
+        return cache.emplace(mangled, std::move(demangled)).first->second;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        for (const auto* mangled : mangled_names) {
+            total_bytes += demangle(mangled).size();
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double lookups_per_sec =
+        static_cast<double>(iterations * std::size(mangled_names)) / elapsed;
+    std::cout << fmt::format("{:<16} {:>14.0f} lookups/sec (cached, {} unique names)",
+                             "demangle", lookups_per_sec, std::size(mangled_names))
+              << std::endl;
+    (void)total_bytes;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t num_records = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4096;
+    size_t mean_name_length = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+    size_t iterations = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000;
+
+    std::mt19937_64 rng(42);
+
+    auto names = generate_names(256, mean_name_length, rng);
+
+    std::uniform_int_distribution<uint32_t> gpu_dist(0, 7);
+    std::uniform_int_distribution<uint64_t> kernel_dist(0, names.size() - 1);
+    std::uniform_int_distribution<uint64_t> duration_dist(1000, 10000000);
+
+    std::vector<SyntheticDispatch> records;
+    records.reserve(num_records);
+    uint64_t timestamp = 1000000000;
+    for (size_t i = 0; i < num_records; ++i) {
+        auto duration = duration_dist(rng);
+        records.push_back({gpu_dist(rng), kernel_dist(rng), timestamp, timestamp + duration});
+        timestamp += duration;
+    }
+
+    std::cout << fmt::format("{} records/payload, mean name length {}, {} iterations",
+                             num_records, mean_name_length, iterations)
+              << std::endl;
+
+    run_benchmark("json", records, iterations, false, false,
+                  [&names](std::string& data, const SyntheticDispatch& record) {
+                      omnistat::append_json_record(data, record.gpu_id, names[record.kernel_id],
+                                                   record.start_ns, record.end_ns);
+                  });
+
+    run_benchmark("json-ids", records, iterations, false, true,
+                  [](std::string& data, const SyntheticDispatch& record) {
+                      omnistat::append_json_id_record(data, record.gpu_id, record.kernel_id,
+                                                      record.start_ns, record.end_ns);
+                  });
+
+    run_benchmark("binary", records, iterations, true, false,
+                  [&names](std::string& data, const SyntheticDispatch& record) {
+                      omnistat::append_binary_record(data, record.gpu_id, names[record.kernel_id],
+                                                     record.start_ns, record.end_ns);
+                  });
+
+    run_benchmark("binary-ids", records, iterations, true, true,
+                  [](std::string& data, const SyntheticDispatch& record) {
+                      omnistat::append_binary_id_record(data, record.gpu_id, record.kernel_id,
+                                                        record.start_ns, record.end_ns);
+                  });
+
+    run_demangle_benchmark(iterations);
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2025 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+#include "trace_file.hpp"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace omnistat {
+
+// Growth step for the mapped file; large enough that extending is rare even
+// under heavy dispatch load, small enough not to matter on node-local NVMe
+constexpr size_t TRACE_FILE_GROW_BYTES = 4 * 1024 * 1024;
+
+static size_t round_up_to_page(size_t bytes) {
+    return (bytes + TRACE_FILE_PAGE_SIZE - 1) & ~(TRACE_FILE_PAGE_SIZE - 1);
+}
+
+static void write_u32(uint8_t* dst, uint32_t value) {
+    std::memcpy(dst, &value, sizeof(value));
+}
+
+static void write_u64(uint8_t* dst, uint64_t value) {
+    std::memcpy(dst, &value, sizeof(value));
+}
+
+TraceFileSink::~TraceFileSink() {
+    close();
+}
+
+bool TraceFileSink::open(const std::string& path) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    capacity_ = TRACE_FILE_GROW_BYTES;
+    if (ftruncate(fd_, capacity_) != 0) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    mapping_ = static_cast<uint8_t*>(mapping);
+
+    // File header; the remainder of the first page stays zero
+    std::memset(mapping_, 0, TRACE_FILE_PAGE_SIZE);
+    std::memcpy(mapping_, "OMTF", 4);
+    mapping_[4] = TRACE_FILE_VERSION;
+    write_u32(mapping_ + 8, static_cast<uint32_t>(TRACE_FILE_PAGE_SIZE));
+    write_offset_ = TRACE_FILE_PAGE_SIZE;
+
+    return true;
+}
+
+bool TraceFileSink::ensure_capacity(size_t bytes) {
+    if (write_offset_ + bytes <= capacity_) {
+        return true;
+    }
+
+    size_t new_capacity = capacity_;
+    while (write_offset_ + bytes > new_capacity) {
+        new_capacity += TRACE_FILE_GROW_BYTES;
+    }
+
+    if (ftruncate(fd_, new_capacity) != 0) {
+        return false;
+    }
+
+    void* mapping = mremap(mapping_, capacity_, new_capacity, MREMAP_MAYMOVE);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    mapping_ = static_cast<uint8_t*>(mapping);
+    capacity_ = new_capacity;
+    return true;
+}
+
+bool TraceFileSink::append_block(std::string_view payload, uint64_t min_timestamp,
+                                 uint64_t max_timestamp, uint32_t record_count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!mapping_) {
+        return false;
+    }
+
+    const size_t block_bytes = round_up_to_page(TRACE_FILE_BLOCK_HEADER_SIZE + payload.size());
+    if (!ensure_capacity(block_bytes)) {
+        // Out of space (or address space): disable the sink but keep what
+        // was already written recoverable through the footer
+        close();
+        return false;
+    }
+
+    uint8_t* block = mapping_ + write_offset_;
+    std::memcpy(block, "OMTB", 4);
+    write_u32(block + 4, static_cast<uint32_t>(payload.size()));
+    write_u32(block + 8, record_count);
+    write_u32(block + 12, 0);
+    write_u64(block + 16, min_timestamp);
+    write_u64(block + 24, max_timestamp);
+    std::memcpy(block + TRACE_FILE_BLOCK_HEADER_SIZE, payload.data(), payload.size());
+
+    const size_t padding = block_bytes - TRACE_FILE_BLOCK_HEADER_SIZE - payload.size();
+    if (padding > 0) {
+        std::memset(block + TRACE_FILE_BLOCK_HEADER_SIZE + payload.size(), 0, padding);
+    }
+
+    index_.push_back({write_offset_, static_cast<uint32_t>(payload.size()), record_count,
+                      min_timestamp, max_timestamp});
+    write_offset_ += block_bytes;
+    blocks_written_++;
+    bytes_written_ += payload.size();
+
+    return true;
+}
+
+void TraceFileSink::close() {
+    if (!mapping_) {
+        return;
+    }
+
+    const size_t footer_bytes =
+        index_.size() * TRACE_FILE_INDEX_ENTRY_SIZE + TRACE_FILE_TRAILER_SIZE;
+
+    if (ensure_capacity(footer_bytes)) {
+        const uint64_t index_offset = write_offset_;
+        uint8_t* entry = mapping_ + write_offset_;
+        for (const auto& block : index_) {
+            write_u64(entry, block.offset);
+            write_u32(entry + 8, block.payload_bytes);
+            write_u32(entry + 12, block.record_count);
+            write_u64(entry + 16, block.min_timestamp);
+            write_u64(entry + 24, block.max_timestamp);
+            entry += TRACE_FILE_INDEX_ENTRY_SIZE;
+        }
+
+        write_u64(entry, index_offset);
+        write_u64(entry + 8, index_.size());
+        write_u32(entry + 16, 0);
+        std::memcpy(entry + 20, "OMTX", 4);
+        write_offset_ += footer_bytes;
+    }
+
+    munmap(mapping_, capacity_);
+    mapping_ = nullptr;
+
+    // Trim the pre-grown file down to exactly what was written, leaving the
+    // trailer as the last bytes of the file where the reader expects it;
+    // shrinking an open file does not fail in practice
+    (void)ftruncate(fd_, write_offset_);
+    ::close(fd_);
+    fd_ = -1;
+}
+
+} // namespace omnistat
@@ -0,0 +1,108 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2025 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace omnistat {
+
+// Append-only memory-mapped trace file for endpoint-less runs
+// (OMNISTAT_TRACE_FILE): buffer callbacks append page-aligned blocks of
+// binary dispatch records, and close() writes a footer index of per-block
+// time ranges so a reader can load a time slice without scanning the file.
+// The matching reader lives in omnistat/trace_file.py.
+//
+// File layout (little-endian):
+//   file header, one page: magic "OMTF" | u8 version | u8[3] reserved |
+//       u32 page size | zero padding
+//   blocks, page-aligned: block header (magic "OMTB" | u32 payload bytes |
+//       u32 record count | u32 reserved | u64 min timestamp | u64 max
+//       timestamp) followed by a standard binary trace payload (see
+//       trace_format.hpp), zero-padded to the next page boundary
+//   footer: one 32-byte index entry per block (u64 block offset | u32
+//       payload bytes | u32 record count | u64 min | u64 max timestamp),
+//       then a 24-byte trailer (u64 index offset | u64 entry count | u32
+//       reserved | magic "OMTX") closing the file
+
+constexpr uint8_t TRACE_FILE_VERSION = 1;
+constexpr size_t TRACE_FILE_PAGE_SIZE = 4096;
+constexpr size_t TRACE_FILE_BLOCK_HEADER_SIZE = 32;
+constexpr size_t TRACE_FILE_INDEX_ENTRY_SIZE = 32;
+constexpr size_t TRACE_FILE_TRAILER_SIZE = 24;
+
+class TraceFileSink {
+  public:
+    TraceFileSink() = default;
+    ~TraceFileSink();
+
+    TraceFileSink(const TraceFileSink&) = delete;
+    TraceFileSink& operator=(const TraceFileSink&) = delete;
+
+    // Create (truncating) and map the trace file; returns false on failure
+    bool open(const std::string& path);
+
+    // Append one block holding a serialized binary trace payload covering
+    // dispatches in [min_timestamp, max_timestamp]. Safe to call from
+    // multiple buffer callback threads. Returns false if the file could not
+    // be grown, after which the sink is disabled.
+    bool append_block(std::string_view payload, uint64_t min_timestamp, uint64_t max_timestamp,
+                      uint32_t record_count);
+
+    // Write the footer index and trailer, trim the file to its final size,
+    // and unmap it; called from the tracer destructor
+    void close();
+
+    bool valid() const { return mapping_ != nullptr; }
+    uint64_t blocks_written() const { return blocks_written_; }
+    uint64_t bytes_written() const { return bytes_written_; }
+
+  private:
+    struct BlockIndexEntry {
+        uint64_t offset;
+        uint32_t payload_bytes;
+        uint32_t record_count;
+        uint64_t min_timestamp;
+        uint64_t max_timestamp;
+    };
+
+    // Grow the mapping so at least bytes more can be appended; the file is
+    // extended in large steps to keep ftruncate/mremap off the hot path
+    bool ensure_capacity(size_t bytes);
+
+    std::mutex mutex_;
+    int fd_ = -1;
+    uint8_t* mapping_ = nullptr;
+    size_t capacity_ = 0;
+    size_t write_offset_ = 0;
+    std::vector<BlockIndexEntry> index_;
+    uint64_t blocks_written_ = 0;
+    uint64_t bytes_written_ = 0;
+};
+
+} // namespace omnistat
@@ -0,0 +1,181 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2025 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+#include "trace_format.hpp"
+
+#include <bit>
+#include <cstring>
+#include <iterator>
+
+#if defined(HAS_STD_FORMAT)
+#include <format>
+namespace fmt = std;
+#else
+#include <fmt/core.h>
+#endif
+
+namespace omnistat {
+
+// Append a fixed-width little-endian integer to the buffer. All supported
+// targets are little-endian, so the encoding is a plain memcpy.
+template <typename T> static void append_le(std::string& buffer, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    buffer.append(bytes, sizeof(T));
+}
+
+void append_binary_header(std::string& buffer, uint32_t num_records, uint8_t flags,
+                          uint32_t client) {
+    buffer.append("OMTR", 4);
+    append_le<uint8_t>(buffer, BINARY_FORMAT_VERSION);
+    append_le<uint8_t>(buffer, flags);
+    append_le<uint16_t>(buffer, 0); // reserved
+    append_le<uint32_t>(buffer, num_records);
+    append_le<uint32_t>(buffer, client);
+}
+
+void append_binary_record(std::string& buffer, uint32_t gpu_id, std::string_view kernel_name,
+                          uint64_t start_ns, uint64_t end_ns) {
+    append_le<uint32_t>(buffer, gpu_id);
+    append_le<uint32_t>(buffer, static_cast<uint32_t>(kernel_name.size()));
+    append_le<uint64_t>(buffer, start_ns);
+    append_le<uint64_t>(buffer, end_ns);
+    buffer.append(kernel_name.data(), kernel_name.size());
+}
+
+void patch_binary_record_count(std::string& buffer, uint32_t num_records) {
+    // The count is the little-endian u32 at offset 8 of the header
+    std::memcpy(buffer.data() + 8, &num_records, sizeof(num_records));
+}
+
+void append_binary_id_record(std::string& buffer, uint32_t gpu_id, uint64_t kernel_id,
+                             uint64_t start_ns, uint64_t end_ns) {
+    append_le<uint32_t>(buffer, gpu_id);
+    append_le<uint32_t>(buffer, 0); // reserved
+    append_le<uint64_t>(buffer, kernel_id);
+    append_le<uint64_t>(buffer, start_ns);
+    append_le<uint64_t>(buffer, end_ns);
+}
+
+// SWAR helpers for the JSON escaping scan: every byte of the word is tested
+// in parallel using the classic zero-byte trick, with the high bit of each
+// byte lane flagging a match
+static constexpr uint64_t repeat_byte(uint8_t value) { return 0x0101010101010101ULL * value; }
+static constexpr uint64_t high_bits = 0x8080808080808080ULL;
+
+static inline uint64_t zero_bytes(uint64_t word) {
+    return (word - repeat_byte(0x01)) & ~word & high_bits;
+}
+
+// Flag bytes that JSON strings can't hold verbatim: quote, backslash, and
+// control characters below 0x20. Bytes with the high bit set (UTF-8
+// continuation bytes in demangled names) pass through untouched.
+static inline uint64_t escape_mask(uint64_t word) {
+    uint64_t quotes = zero_bytes(word ^ repeat_byte('"'));
+    uint64_t backslashes = zero_bytes(word ^ repeat_byte('\\'));
+    uint64_t controls = (word - repeat_byte(0x20)) & ~word & high_bits;
+    return quotes | backslashes | controls;
+}
+
+static inline bool needs_escape(unsigned char byte) {
+    return byte == '"' || byte == '\\' || byte < 0x20;
+}
+
+static void append_escaped_byte(std::string& buffer, unsigned char byte) {
+    switch (byte) {
+    case '"':
+        buffer.append("\\\"");
+        break;
+    case '\\':
+        buffer.append("\\\\");
+        break;
+    case '\n':
+        buffer.append("\\n");
+        break;
+    case '\t':
+        buffer.append("\\t");
+        break;
+    case '\r':
+        buffer.append("\\r");
+        break;
+    default:
+        fmt::format_to(std::back_inserter(buffer), "\\u{:04x}", byte);
+        break;
+    }
+}
+
+void append_json_escaped(std::string& buffer, std::string_view text) {
+    const char* data = text.data();
+    const size_t size = text.size();
+
+    size_t pos = 0;
+    size_t clean_start = 0;
+
+    // Scan 8 bytes per step; on a match copy the clean run so far, escape the
+    // offending byte, and resume scanning right after it. Clean strings take
+    // a single bulk append at the end.
+    while (pos + sizeof(uint64_t) <= size) {
+        uint64_t word;
+        std::memcpy(&word, data + pos, sizeof(word));
+
+        uint64_t mask = escape_mask(word);
+        if (mask == 0) {
+            pos += sizeof(uint64_t);
+            continue;
+        }
+
+        // Lowest set high bit identifies the first matching byte lane
+        size_t offset = static_cast<size_t>(std::countr_zero(mask)) / 8;
+        buffer.append(data + clean_start, pos + offset - clean_start);
+        append_escaped_byte(buffer, static_cast<unsigned char>(data[pos + offset]));
+        pos += offset + 1;
+        clean_start = pos;
+    }
+
+    for (; pos < size; ++pos) {
+        auto byte = static_cast<unsigned char>(data[pos]);
+        if (needs_escape(byte)) {
+            buffer.append(data + clean_start, pos - clean_start);
+            append_escaped_byte(buffer, byte);
+            clean_start = pos + 1;
+        }
+    }
+
+    buffer.append(data + clean_start, size - clean_start);
+}
+
+void append_json_record(std::string& buffer, uint32_t gpu_id, std::string_view kernel_name,
+                        uint64_t start_ns, uint64_t end_ns) {
+    fmt::format_to(std::back_inserter(buffer), "[{},\"", gpu_id);
+    append_json_escaped(buffer, kernel_name);
+    fmt::format_to(std::back_inserter(buffer), "\",{},{}],", start_ns, end_ns);
+}
+
+void append_json_id_record(std::string& buffer, uint32_t gpu_id, uint64_t kernel_id,
+                           uint64_t start_ns, uint64_t end_ns) {
+    fmt::format_to(std::back_inserter(buffer), "[{},{},{},{}],", gpu_id, kernel_id, start_ns,
+                   end_ns);
+}
+
+} // namespace omnistat
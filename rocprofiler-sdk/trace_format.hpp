@@ -0,0 +1,100 @@
+// ---------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2025 Advanced Micro Devices, Inc. All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// ---------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace omnistat {
+
+// Wire formats for kernel trace flush payloads. The JSON format is the
+// default and encodes each dispatch as a [gpu_id, "kernel_name", start_ns,
+// end_ns] array element. The binary format trades readability for a
+// memcpy-class encoding: a fixed 16-byte header followed by length-prefixed
+// records with fixed-width fields, all little-endian. The Python endpoint
+// selects the decoder based on the Content-Type of the POST.
+//
+// Binary layout:
+//   header: magic "OMTR" | u8 version | u8 flags | u16 reserved | u32
+//           num_records | u32 client
+//   record: u32 gpu_id | u32 name_length | u64 start_ns | u64 end_ns |
+//           name bytes (name_length, no padding)
+//   record (kernel-ID flag): u32 gpu_id | u32 reserved | u64 kernel_id |
+//           u64 start_ns | u64 end_ns
+enum class TraceFormat {
+    Json,
+    Binary,
+};
+
+// Content-Type value identifying binary payloads to the endpoint
+constexpr const char* BINARY_CONTENT_TYPE = "application/x-omnistat-trace";
+
+// Version byte of the binary format header
+constexpr uint8_t BINARY_FORMAT_VERSION = 1;
+
+// Header flag set when records reference kernels by dictionary ID instead of
+// embedding the demangled name. The client field of the header identifies the
+// sending process so the endpoint can scope dictionary lookups per process.
+constexpr uint8_t BINARY_FLAG_KERNEL_IDS = 0x1;
+
+// Fixed sizes of the binary header and the fixed-width portion of a record
+constexpr size_t BINARY_HEADER_SIZE = 16;
+constexpr size_t BINARY_RECORD_FIXED_SIZE = 24;
+constexpr size_t BINARY_ID_RECORD_SIZE = 32;
+
+// Append a binary payload header for num_records records
+void append_binary_header(std::string& buffer, uint32_t num_records, uint8_t flags = 0,
+                          uint32_t client = 0);
+
+// Patch the record count of a header previously appended at the start of the
+// buffer, for payloads where the count isn't known upfront
+void patch_binary_record_count(std::string& buffer, uint32_t num_records);
+
+// Append one dispatch record in the binary format
+void append_binary_record(std::string& buffer, uint32_t gpu_id, std::string_view kernel_name,
+                          uint64_t start_ns, uint64_t end_ns);
+
+// Append one dispatch record in the binary format, referencing the kernel by
+// dictionary ID (requires BINARY_FLAG_KERNEL_IDS in the header)
+void append_binary_id_record(std::string& buffer, uint32_t gpu_id, uint64_t kernel_id,
+                             uint64_t start_ns, uint64_t end_ns);
+
+// Append text as the contents of a JSON string, escaping quotes, backslashes,
+// and control characters. Clean input — the overwhelmingly common case for
+// kernel names — is detected with a SWAR scan (8 bytes per step) and copied
+// in bulk; only bytes that need escaping fall back to per-byte handling.
+void append_json_escaped(std::string& buffer, std::string_view text);
+
+// Append one dispatch record as a JSON array element followed by a comma
+void append_json_record(std::string& buffer, uint32_t gpu_id, std::string_view kernel_name,
+                        uint64_t start_ns, uint64_t end_ns);
+
+// Append one dispatch record as a JSON array element referencing the kernel
+// by dictionary ID, followed by a comma
+void append_json_id_record(std::string& buffer, uint32_t gpu_id, uint64_t kernel_id,
+                           uint64_t start_ns, uint64_t end_ns);
+
+} // namespace omnistat
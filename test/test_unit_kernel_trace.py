@@ -6,7 +6,7 @@ import orjson
 import pytest
 from flask import Flask
 
-from omnistat.collector_kernel_trace import KernelTrace
+from omnistat.collector_kernel_trace import HEALTH_FIELDS, KernelTrace, latency_percentile
 
 
 def s_to_ns(s):
@@ -517,6 +517,206 @@ class TestHandleRequest:
         assert collector_instance._KernelTrace__dispatches[0] == (0, "kernel_a", s_to_ns(3), s_to_ns(2))
 
 
+def pack_binary(records, magic=b"OMTR", version=1):
+    """Build a binary trace payload matching rocprofiler-sdk/trace_format.hpp:
+    16-byte header + length-prefixed records with fixed-width fields."""
+    import struct
+
+    payload = struct.pack("<4sBBHII", magic, version, 0, 0, len(records), 0)
+    for gpu_id, kernel, start_ns, end_ns in records:
+        name = kernel.encode()
+        payload += struct.pack("<IIQQ", gpu_id, len(name), start_ns, end_ns) + name
+    return payload
+
+
+BINARY_CONTENT_TYPE = "application/x-omnistat-trace"
+
+
+class TestHandleRequestBinary:
+    def test_binary_format(self, collector_instance, flask_app):
+        """Parses binary records into the same dispatch tuples as JSON input."""
+        data = pack_binary([(0, "kernel_a", s_to_ns(1), s_to_ns(2)), (1, "kernel_b", s_to_ns(3), s_to_ns(4))])
+
+        with flask_app.test_request_context(data=data, content_type=BINARY_CONTENT_TYPE):
+            response, status = collector_instance.handleRequest()
+
+            assert status == 204
+            assert len(collector_instance._KernelTrace__dispatches) == 2
+            assert collector_instance._KernelTrace__dispatches[0] == (0, "kernel_a", s_to_ns(2), s_to_ns(1))
+
+    def test_empty_binary_payload(self, collector_instance, flask_app):
+        """A header-only payload with zero records returns 204 and adds nothing."""
+        with flask_app.test_request_context(data=pack_binary([]), content_type=BINARY_CONTENT_TYPE):
+            response, status = collector_instance.handleRequest()
+
+            assert status == 204
+            assert len(collector_instance._KernelTrace__dispatches) == 0
+
+    def test_complex_kernel_names(self, collector_instance, flask_app):
+        """Kernel names with C++ template syntax survive the binary round trip."""
+        name = "std::vector<int>::push_back(int const&)"
+        data = pack_binary([(0, name, 100, 200)])
+
+        with flask_app.test_request_context(data=data, content_type=BINARY_CONTENT_TYPE):
+            response, status = collector_instance.handleRequest()
+
+            assert status == 204
+            assert collector_instance._KernelTrace__dispatches[0][1] == name
+
+    def test_bad_magic(self, collector_instance, flask_app):
+        """A payload with the wrong magic returns 400 and adds no dispatches."""
+        data = pack_binary([(0, "kernel_a", 100, 200)], magic=b"XXXX")
+
+        with flask_app.test_request_context(data=data, content_type=BINARY_CONTENT_TYPE):
+            _, status = collector_instance.handleRequest()
+
+        assert status == 400
+        assert len(collector_instance._KernelTrace__dispatches) == 0
+
+    def test_unsupported_version(self, collector_instance, flask_app):
+        """A payload with an unknown version returns 400 and adds no dispatches."""
+        data = pack_binary([(0, "kernel_a", 100, 200)], version=99)
+
+        with flask_app.test_request_context(data=data, content_type=BINARY_CONTENT_TYPE):
+            _, status = collector_instance.handleRequest()
+
+        assert status == 400
+        assert len(collector_instance._KernelTrace__dispatches) == 0
+
+    def test_truncated_payload(self, collector_instance, flask_app):
+        """A payload cut short mid-record returns 400 and adds no dispatches."""
+        data = pack_binary([(0, "kernel_a", 100, 200)])[:-4]
+
+        with flask_app.test_request_context(data=data, content_type=BINARY_CONTENT_TYPE):
+            _, status = collector_instance.handleRequest()
+
+        assert status == 400
+        assert len(collector_instance._KernelTrace__dispatches) == 0
+
+
+def pack_binary_ids(records, client, magic=b"OMTR", version=1):
+    """Build a binary trace payload with the kernel-IDs flag set, where each
+    record references the kernel by dictionary ID instead of name."""
+    import struct
+
+    payload = struct.pack("<4sBBHII", magic, version, 0x1, 0, len(records), client)
+    for gpu_id, kernel_id, start_ns, end_ns in records:
+        payload += struct.pack("<IIQQQ", gpu_id, 0, kernel_id, start_ns, end_ns)
+    return payload
+
+
+class TestKernelDictionary:
+    def sync_dict(self, collector_instance, flask_app, client, kernels):
+        data = orjson.dumps({"client": client, "kernels": kernels})
+        with flask_app.test_request_context(data=data, content_type="application/json"):
+            return collector_instance.handleDictRequest()
+
+    def test_dict_sync(self, collector_instance, flask_app):
+        """Dictionary entries are stored scoped by (client, kernel_id)."""
+        _, status = self.sync_dict(collector_instance, flask_app, 42, [[7, "kernel_a"], [8, "kernel_b"]])
+
+        assert status == 204
+        kernel_dicts = collector_instance._KernelTrace__kernel_dicts
+        assert kernel_dicts[(42, 7)] == "kernel_a"
+        assert kernel_dicts[(42, 8)] == "kernel_b"
+
+    def test_json_id_records(self, collector_instance, flask_app):
+        """Wrapped JSON payloads with integer kernel IDs resolve to synced names."""
+        self.sync_dict(collector_instance, flask_app, 42, [[7, "kernel_a"]])
+
+        data = orjson.dumps({"client": 42, "records": [[0, 7, s_to_ns(1), s_to_ns(2)]]})
+        with flask_app.test_request_context(data=data, content_type="application/json"):
+            _, status = collector_instance.handleRequest()
+
+        assert status == 204
+        assert collector_instance._KernelTrace__dispatches[0] == (0, "kernel_a", s_to_ns(2), s_to_ns(1))
+
+    def test_binary_id_records(self, collector_instance, flask_app):
+        """Binary payloads with the kernel-IDs flag resolve to synced names."""
+        self.sync_dict(collector_instance, flask_app, 42, [[7, "kernel_a"]])
+
+        data = pack_binary_ids([(1, 7, s_to_ns(3), s_to_ns(4))], client=42)
+        with flask_app.test_request_context(data=data, content_type=BINARY_CONTENT_TYPE):
+            _, status = collector_instance.handleRequest()
+
+        assert status == 204
+        assert collector_instance._KernelTrace__dispatches[0] == (1, "kernel_a", s_to_ns(4), s_to_ns(1))
+
+    def test_clients_are_scoped(self, collector_instance, flask_app):
+        """The same kernel ID from different clients resolves independently."""
+        self.sync_dict(collector_instance, flask_app, 1, [[7, "kernel_a"]])
+        self.sync_dict(collector_instance, flask_app, 2, [[7, "kernel_b"]])
+
+        data = pack_binary_ids([(0, 7, s_to_ns(1), s_to_ns(2))], client=2)
+        with flask_app.test_request_context(data=data, content_type=BINARY_CONTENT_TYPE):
+            collector_instance.handleRequest()
+
+        assert collector_instance._KernelTrace__dispatches[0][1] == "kernel_b"
+
+    def test_unknown_id_placeholder(self, collector_instance, flask_app):
+        """Records referencing an unsynced ID use a placeholder name."""
+        data = pack_binary_ids([(0, 99, s_to_ns(1), s_to_ns(2))], client=42)
+        with flask_app.test_request_context(data=data, content_type=BINARY_CONTENT_TYPE):
+            _, status = collector_instance.handleRequest()
+
+        assert status == 204
+        assert collector_instance._KernelTrace__dispatches[0][1] == "unknown_kernel_99"
+
+    def test_malformed_dict_payload(self, collector_instance, flask_app):
+        """A dictionary payload without the expected fields returns 400."""
+        data = orjson.dumps({"client": 42})
+        with flask_app.test_request_context(data=data, content_type="application/json"):
+            _, status = collector_instance.handleDictRequest()
+
+        assert status == 400
+
+
+class TestHandleAggregate:
+    def post_aggregate(self, collector_instance, flask_app, client, entries):
+        data = orjson.dumps({"client": client, "aggregate": entries})
+        with flask_app.test_request_context(data=data, content_type="application/json"):
+            return collector_instance.handleRequest()
+
+    def test_aggregate_entries(self, collector_instance, flask_app):
+        """Aggregate entries queue (gpu_id, name, count, total) tuples."""
+        entries = [[0, "kernel_a", 5, 1000, 100, 400, [0, 2, 3]]]
+        _, status = self.post_aggregate(collector_instance, flask_app, 42, entries)
+
+        assert status == 204
+        assert collector_instance._KernelTrace__aggregates == [(0, "kernel_a", 5, 1000)]
+
+    def test_aggregate_feeds_time_series(self, collector_instance, mock_time, flask_app):
+        """Aggregate counts and durations land in the current bin."""
+        entries = [[0, "kernel_a", 5, 1000, 100, 400, [0, 2, 3]]]
+        self.post_aggregate(collector_instance, flask_app, 42, entries)
+
+        set_time(mock_time, FIRST_BIN_S)
+        collector_instance.updateMetrics()
+
+        values = collector_instance._KernelTrace__values[(0, "kernel_a")]
+        assert values == [5, 1000]
+
+    def test_aggregate_with_kernel_ids(self, collector_instance, flask_app):
+        """Aggregate entries may reference kernels by dictionary ID."""
+        dict_data = orjson.dumps({"client": 42, "kernels": [[7, "kernel_a"]]})
+        with flask_app.test_request_context(data=dict_data, content_type="application/json"):
+            collector_instance.handleDictRequest()
+
+        entries = [[1, 7, 3, 600, 100, 300, [1, 1, 1]]]
+        _, status = self.post_aggregate(collector_instance, flask_app, 42, entries)
+
+        assert status == 204
+        assert collector_instance._KernelTrace__aggregates == [(1, "kernel_a", 3, 600)]
+
+    def test_malformed_aggregate(self, collector_instance, flask_app):
+        """Aggregate entries with missing fields return 400."""
+        entries = [[0, "kernel_a", 5]]
+        _, status = self.post_aggregate(collector_instance, flask_app, 42, entries)
+
+        assert status == 400
+        assert collector_instance._KernelTrace__aggregates == []
+
+
 class TestKernelNameInterning:
     def test_same_object(self, collector_instance, flask_app):
         """Same kernel name submitted twice -> same Python object (identity)."""
@@ -612,3 +812,244 @@ class TestThreadSafety:
 
         # 3 first batch + 2 second batch = 5 total
         assert collector_instance._KernelTrace__values[(0, "kernel_a")][0] == 5
+
+
+class TestCompressedPayload:
+    def test_zstd_json_round_trip(self, collector_instance, flask_app):
+        """A zstd-encoded JSON payload decompresses into the same dispatches."""
+        zstandard = pytest.importorskip("zstandard")
+        json_data = orjson.dumps([[0, "kernel_a", s_to_ns(1), s_to_ns(2)]])
+        compressed = zstandard.ZstdCompressor().compress(json_data)
+
+        with flask_app.test_request_context(
+            data=compressed, content_type="application/json", headers={"Content-Encoding": "zstd"}
+        ):
+            _, status = collector_instance.handleRequest()
+
+        assert status == 204
+        assert collector_instance._KernelTrace__dispatches[0] == (0, "kernel_a", s_to_ns(2), s_to_ns(1))
+
+    def test_zstd_binary_round_trip(self, collector_instance, flask_app):
+        """Compression applies to binary payloads as well."""
+        zstandard = pytest.importorskip("zstandard")
+        data = pack_binary([(1, "kernel_b", s_to_ns(3), s_to_ns(4))])
+        compressed = zstandard.ZstdCompressor().compress(data)
+
+        with flask_app.test_request_context(
+            data=compressed, content_type=BINARY_CONTENT_TYPE, headers={"Content-Encoding": "zstd"}
+        ):
+            _, status = collector_instance.handleRequest()
+
+        assert status == 204
+        assert collector_instance._KernelTrace__dispatches[0] == (1, "kernel_b", s_to_ns(4), s_to_ns(1))
+
+    def test_zstd_without_library(self, collector_instance, flask_app, monkeypatch):
+        """A zstd-encoded payload without the zstandard package returns 400."""
+        import omnistat.collector_kernel_trace as module
+
+        monkeypatch.setattr(module, "zstandard", None)
+        with flask_app.test_request_context(
+            data=b"\x28\xb5\x2f\xfd", content_type="application/json", headers={"Content-Encoding": "zstd"}
+        ):
+            _, status = collector_instance.handleRequest()
+
+        assert status == 400
+        assert len(collector_instance._KernelTrace__dispatches) == 0
+
+
+class TestTracerHealth:
+    def make_health(self, **overrides):
+        health = {field: 0 for field in HEALTH_FIELDS}
+        health["post_latency_us_buckets"] = [0] * 24
+        health.update(overrides)
+        return health
+
+    def post_health(self, collector_instance, flask_app, client, health):
+        data = orjson.dumps({"client": client, "health": health})
+        with flask_app.test_request_context(data=data, content_type="application/json"):
+            return collector_instance.handleHealthRequest()
+
+    def collect_tracer_lines(self, collector_instance):
+        lines = collector_instance.formatMetrics(LABEL_DEFAULTS, flush=True)
+        return [l.decode() for l in lines if l.startswith(b"omnistat_kernel_tracer_")]
+
+    def test_health_stored_per_client(self, collector_instance, mock_time, flask_app):
+        """Health payloads are keyed by client and timestamped at receipt."""
+        _, status = self.post_health(collector_instance, flask_app, 42, self.make_health(records=7))
+
+        assert status == 204
+        health, received_ms = collector_instance._KernelTrace__health[42]
+        assert health["records"] == 7
+        assert received_ms == 1000
+
+    def test_counter_lines(self, collector_instance, mock_time, flask_app):
+        """formatMetrics exports one omnistat_kernel_tracer_* line per counter."""
+        self.post_health(collector_instance, flask_app, 42, self.make_health(records=100, flushes=4))
+
+        lines = self.collect_tracer_lines(collector_instance)
+
+        assert f'omnistat_kernel_tracer_records{{{LABEL_DEFAULTS},client="42"}} 100 1000' in lines
+        assert f'omnistat_kernel_tracer_flushes{{{LABEL_DEFAULTS},client="42"}} 4 1000' in lines
+        # 12 counters + 3 latency quantiles
+        assert len(lines) == len(HEALTH_FIELDS) + 3
+
+    def test_latency_quantile_lines(self, collector_instance, mock_time, flask_app):
+        """Latency quantiles are computed from the histogram as upper bounds in ns."""
+        buckets = [0] * 24
+        buckets[3] = 90  # 90 attempts in [4, 8) us
+        buckets[10] = 10  # 10 attempts in [512, 1024) us
+        self.post_health(collector_instance, flask_app, 42, self.make_health(post_latency_us_buckets=buckets))
+
+        lines = self.collect_tracer_lines(collector_instance)
+
+        labels = f'{LABEL_DEFAULTS},client="42"'
+        assert f'omnistat_kernel_tracer_post_latency_ns{{{labels},quantile="0.5"}} 8000 1000' in lines
+        assert f'omnistat_kernel_tracer_post_latency_ns{{{labels},quantile="0.95"}} 1024000 1000' in lines
+
+    def test_stale_clients_age_out(self, collector_instance, mock_time, flask_app):
+        """Entries from exited tracers are pruned after the 60s TTL."""
+        self.post_health(collector_instance, flask_app, 42, self.make_health())
+
+        set_time(mock_time, 100)
+        lines = self.collect_tracer_lines(collector_instance)
+
+        assert lines == []
+        assert 42 not in collector_instance._KernelTrace__health
+
+    def test_multiple_clients(self, collector_instance, mock_time, flask_app):
+        """Two tracers report independently, distinguished by the client label."""
+        self.post_health(collector_instance, flask_app, 1, self.make_health(records=10))
+        self.post_health(collector_instance, flask_app, 2, self.make_health(records=20))
+
+        lines = self.collect_tracer_lines(collector_instance)
+
+        assert f'omnistat_kernel_tracer_records{{{LABEL_DEFAULTS},client="1"}} 10 1000' in lines
+        assert f'omnistat_kernel_tracer_records{{{LABEL_DEFAULTS},client="2"}} 20 1000' in lines
+
+    def test_malformed_health_payload(self, collector_instance, flask_app):
+        """A payload without the expected fields returns 400."""
+        data = orjson.dumps({"records": 7})
+        with flask_app.test_request_context(data=data, content_type="application/json"):
+            _, status = collector_instance.handleHealthRequest()
+
+        assert status == 400
+        assert len(collector_instance._KernelTrace__health) == 0
+
+    def test_missing_counter_field(self, collector_instance, flask_app):
+        """A health object lacking a required counter is rejected, not stored
+        where it would break every scrape until the TTL expires."""
+        health = self.make_health()
+        del health["queue_depth"]
+        _, status = self.post_health(collector_instance, flask_app, 42, health)
+
+        assert status == 400
+        assert len(collector_instance._KernelTrace__health) == 0
+
+    def test_non_list_latency_buckets(self, collector_instance, flask_app):
+        """post_latency_us_buckets must be a list of counts."""
+        _, status = self.post_health(
+            collector_instance, flask_app, 42, self.make_health(post_latency_us_buckets="busy")
+        )
+
+        assert status == 400
+        assert len(collector_instance._KernelTrace__health) == 0
+
+    def test_non_object_health(self, collector_instance, flask_app):
+        """A health value that is not an object is rejected."""
+        _, status = self.post_health(collector_instance, flask_app, 42, [1, 2, 3])
+
+        assert status == 400
+        assert len(collector_instance._KernelTrace__health) == 0
+
+
+class TestLatencyPercentile:
+    def test_empty_histogram(self):
+        """All-zero buckets yield 0 rather than a fabricated latency."""
+        assert latency_percentile([0] * 24, 0.99) == 0
+
+    def test_single_bucket(self):
+        """All mass in bucket b -> upper bound 2^b microseconds for any quantile."""
+        buckets = [0] * 24
+        buckets[5] = 100
+        assert latency_percentile(buckets, 0.5) == (1 << 5) * 1_000
+        assert latency_percentile(buckets, 0.99) == (1 << 5) * 1_000
+
+    def test_split_histogram(self):
+        """Quantiles below/above the split resolve to the respective buckets."""
+        buckets = [0] * 24
+        buckets[2] = 50
+        buckets[8] = 50
+        assert latency_percentile(buckets, 0.5) == (1 << 2) * 1_000
+        assert latency_percentile(buckets, 0.51) == (1 << 8) * 1_000
+
+
+class TestAnnotationWindows:
+    def post_window(self, collector_instance, flask_app, client, window):
+        data = orjson.dumps({"client": client, "window": window})
+        with flask_app.test_request_context(data=data, content_type="application/json"):
+            return collector_instance.handleRequest()
+
+    def make_window(self, **overrides):
+        window = {
+            "annotation": "training",
+            "start_ns": s_to_ns(2),
+            "end_ns": s_to_ns(5),
+            "kernels": [[0, "kernel_a", 5, 1000, 100, 400, [0, 2, 3]]],
+        }
+        window.update(overrides)
+        return window
+
+    def test_window_stored(self, collector_instance, mock_time, flask_app):
+        """A window roll-up is retained with its label, boundaries, and entries."""
+        _, status = self.post_window(collector_instance, flask_app, 42, self.make_window())
+
+        assert status == 204
+        windows = collector_instance._KernelTrace__windows
+        assert len(windows) == 1
+        assert windows[0]["client"] == 42
+        assert windows[0]["annotation"] == "training"
+        assert windows[0]["kernels"] == [[0, "kernel_a", 5, 1000, 100, 400, [0, 2, 3]]]
+
+    def test_timestamps_converted_to_unix(self, collector_instance, mock_time, flask_app):
+        """Window boundaries are shifted by the GPU-to-unix clock offset."""
+        mock_time["time_ns"].return_value = s_to_ns(10)
+        mock_time["clock_gettime_ns"].return_value = s_to_ns(3)
+        kt = KernelTrace(configparser.ConfigParser(), Mock(), INTERVAL_S)
+
+        self.post_window(kt, flask_app, 42, self.make_window())
+
+        window = kt._KernelTrace__windows[0]
+        assert window["start_ns"] == s_to_ns(2 + 7)
+        assert window["end_ns"] == s_to_ns(5 + 7)
+
+    def test_kernel_ids_resolved(self, collector_instance, flask_app):
+        """Entries referencing kernels by dictionary ID resolve to synced names."""
+        dict_data = orjson.dumps({"client": 42, "kernels": [[7, "kernel_a"]]})
+        with flask_app.test_request_context(data=dict_data, content_type="application/json"):
+            collector_instance.handleDictRequest()
+
+        window = self.make_window(kernels=[[1, 7, 3, 600, 100, 300, [1, 1, 1]]])
+        _, status = self.post_window(collector_instance, flask_app, 42, window)
+
+        assert status == 204
+        assert collector_instance._KernelTrace__windows[0]["kernels"][0][1] == "kernel_a"
+
+    def test_windows_served_as_json(self, collector_instance, mock_time, flask_app):
+        """The GET route returns the retained windows as a JSON list."""
+        self.post_window(collector_instance, flask_app, 1, self.make_window(annotation="warmup"))
+        self.post_window(collector_instance, flask_app, 1, self.make_window(annotation="training"))
+
+        body, status, headers = collector_instance.handleWindowsRequest()
+
+        assert status == 200
+        assert headers["Content-Type"] == "application/json"
+        windows = orjson.loads(body)
+        assert [w["annotation"] for w in windows] == ["warmup", "training"]
+
+    def test_malformed_window(self, collector_instance, flask_app):
+        """A window payload missing fields returns 400 and stores nothing."""
+        window = {"annotation": "training"}
+        _, status = self.post_window(collector_instance, flask_app, 42, window)
+
+        assert status == 400
+        assert len(collector_instance._KernelTrace__windows) == 0
@@ -0,0 +1,159 @@
+import struct
+import threading
+
+import pytest
+
+from omnistat.shm_metrics import ShmMetricsReader
+
+_HEADER_SIZE = 64
+_SLOT_SIZE = 64
+_NAME_OFFSET = 20
+_NAME_SIZE = 40
+
+_HEADER = struct.Struct("<IIII")
+_SLOT_FIXED = struct.Struct("<QdI")
+
+
+def make_slot(device, name, value, seq=2):
+    """Serialize one 64-byte metric slot matching the C++ ShmMetricSlot
+    layout: seq u64, value f64, device u32, NUL-padded name char[40]."""
+    slot = _SLOT_FIXED.pack(seq, value, device)
+    slot += name.encode()[:_NAME_SIZE].ljust(_NAME_SIZE, b"\0")
+    return slot.ljust(_SLOT_SIZE, b"\0")
+
+
+def make_segment(path, slots, num_devices=None, magic=0x4D534D4F, version=1):
+    """Write a segment with the given (device, name, value) slots, mirroring
+    the layout created by ShmMetricsSegment (rocprofiler-sdk/shm_metrics.cpp)."""
+    if num_devices is None:
+        num_devices = len({device for device, _, _ in slots})
+    header = _HEADER.pack(magic, version, len(slots), num_devices)
+    data = header.ljust(_HEADER_SIZE, b"\0")
+    for device, name, value in slots:
+        data += make_slot(device, name, value)
+    path.write_bytes(data)
+    return path
+
+
+@pytest.fixture
+def segment_path(tmp_path):
+    return make_segment(
+        tmp_path / "metrics.shm",
+        [
+            (0, "GRBM_COUNT", 100.0),
+            (0, "SQ_WAVES", 2.5),
+            (1, "GRBM_COUNT", 300.0),
+        ],
+    )
+
+
+class TestSegmentValidation:
+    def test_rejects_wrong_magic(self, tmp_path):
+        """A file without the OMSM magic is rejected."""
+        path = make_segment(tmp_path / "bogus.shm", [(0, "GRBM_COUNT", 1.0)], magic=0x12345678)
+
+        with pytest.raises(ValueError, match="Not a shared metrics segment"):
+            ShmMetricsReader(path)
+
+    def test_rejects_unknown_version(self, tmp_path):
+        """A version this reader doesn't understand is rejected."""
+        path = make_segment(tmp_path / "metrics.shm", [(0, "GRBM_COUNT", 1.0)], version=9)
+
+        with pytest.raises(ValueError, match="Unsupported shared metrics segment version"):
+            ShmMetricsReader(path)
+
+
+class TestByteLayout:
+    def test_golden_segment(self, tmp_path):
+        """Pin the byte layout with a handcrafted segment, so the fixture
+        writer and the reader can't drift together: one slot, device 7,
+        metric "m", value 2.0, seq 4."""
+        header = b"OMSM" + b"\x01\x00\x00\x00" + b"\x01\x00\x00\x00" + b"\x01\x00\x00\x00"
+        slot = (
+            b"\x04" + b"\x00" * 7  # seq
+            + b"\x00\x00\x00\x00\x00\x00\x00\x40"  # 2.0 as little-endian f64
+            + b"\x07\x00\x00\x00"  # device
+            + b"m" + b"\x00" * 39  # name char[40]
+            + b"\x00" * 4  # pad to 64 bytes
+        )
+        path = tmp_path / "golden.shm"
+        path.write_bytes(header.ljust(_HEADER_SIZE, b"\0") + slot)
+
+        reader = ShmMetricsReader(path)
+        assert reader.num_devices == 1
+        assert reader.read() == [(7, "m", 2.0)]
+        reader.close()
+
+    def test_name_uses_full_forty_bytes(self, tmp_path):
+        """A name filling char[40] exactly (no NUL) is decoded whole, and
+        longer names arrive truncated by the writer."""
+        name = "X" * _NAME_SIZE
+        path = make_segment(tmp_path / "metrics.shm", [(0, name + "overflow", 1.0)])
+
+        reader = ShmMetricsReader(path)
+        assert reader.read() == [(0, name, 1.0)]
+        reader.close()
+
+
+class TestRead:
+    def test_slots_in_segment_order(self, segment_path):
+        """read() yields one (device, name, value) tuple per slot."""
+        reader = ShmMetricsReader(segment_path)
+
+        assert reader.num_devices == 2
+        assert reader.read() == [
+            (0, "GRBM_COUNT", 100.0),
+            (0, "SQ_WAVES", 2.5),
+            (1, "GRBM_COUNT", 300.0),
+        ]
+        reader.close()
+
+    def test_sees_republished_values(self, segment_path):
+        """Value updates published after the reader mapped the segment are
+        visible on the next read; names and devices stay as decoded once."""
+        reader = ShmMetricsReader(segment_path)
+        reader.read()
+
+        data = bytearray(segment_path.read_bytes())
+        _SLOT_FIXED.pack_into(data, _HEADER_SIZE, 4, 150.0, 0)
+        segment_path.write_bytes(bytes(data))
+
+        # The reader holds its own mapping of the original file; re-open to
+        # model a scrape after the writer republished
+        reader.close()
+        reader = ShmMetricsReader(segment_path)
+        assert reader.read()[0] == (0, "GRBM_COUNT", 150.0)
+        reader.close()
+
+
+class TestSeqlock:
+    def test_retries_mid_write_slot(self, tmp_path):
+        """A slot marked mid-write (odd seq) is re-read until the writer
+        publishes, so torn values are never returned."""
+        path = make_segment(tmp_path / "metrics.shm", [(0, "GRBM_COUNT", 1.0)])
+
+        # Mark the slot mid-write through a shared writable mapping
+        import mmap, os
+
+        fd = os.open(path, os.O_RDWR)
+        writer_map = mmap.mmap(fd, 0)
+        os.close(fd)
+        _SLOT_FIXED.pack_into(writer_map, _HEADER_SIZE, 3, 0.0, 0)
+
+        reader = ShmMetricsReader(path)
+        result = []
+        thread = threading.Thread(target=lambda: result.extend(reader.read()))
+        thread.start()
+
+        # The reader must spin on the odd sequence rather than return
+        thread.join(timeout=0.2)
+        assert thread.is_alive()
+
+        # Publish: new value, sequence becomes even again
+        _SLOT_FIXED.pack_into(writer_map, _HEADER_SIZE, 4, 42.0, 0)
+        thread.join(timeout=5)
+        assert not thread.is_alive()
+        assert result == [(0, "GRBM_COUNT", 42.0)]
+
+        reader.close()
+        writer_map.close()
@@ -0,0 +1,225 @@
+import struct
+
+import pytest
+
+from omnistat.trace_file import TraceFileReader
+
+PAGE_SIZE = 4096
+
+_FILE_HEADER = struct.Struct("<4sB3xI")
+_PAYLOAD_HEADER = struct.Struct("<4sBBHII")
+_PAYLOAD_RECORD = struct.Struct("<IIQQ")
+_BLOCK_HEADER = struct.Struct("<4sIIIQQ")
+_INDEX_ENTRY = struct.Struct("<QIIQQ")
+_TRAILER = struct.Struct("<QQI4s")
+
+
+def make_payload(records):
+    """Serialize (gpu_id, name, start_ns, end_ns) records as one binary trace
+    payload, matching rocprofiler-sdk/trace_format.hpp."""
+    payload = bytearray(_PAYLOAD_HEADER.pack(b"OMTR", 1, 0, 0, len(records), 0))
+    for gpu_id, name, start_ns, end_ns in records:
+        encoded = name.encode()
+        payload += _PAYLOAD_RECORD.pack(gpu_id, len(encoded), start_ns, end_ns)
+        payload += encoded
+    return bytes(payload)
+
+
+def write_trace_file(path, blocks):
+    """Write a trace file with one block per record list, mirroring the
+    layout produced by TraceFileSink (rocprofiler-sdk/trace_file.cpp):
+    header page, page-aligned blocks, footer index, trailer."""
+    buf = bytearray(_FILE_HEADER.pack(b"OMTF", 1, PAGE_SIZE))
+    buf += b"\0" * (PAGE_SIZE - len(buf))
+
+    index = []
+    for records in blocks:
+        payload = make_payload(records)
+        min_ns = min(r[2] for r in records)
+        max_ns = max(r[3] for r in records)
+        offset = len(buf)
+        buf += _BLOCK_HEADER.pack(b"OMTB", len(payload), len(records), 0, min_ns, max_ns)
+        buf += payload
+        buf += b"\0" * (-len(buf) % PAGE_SIZE)
+        index.append((offset, len(payload), len(records), min_ns, max_ns))
+
+    index_offset = len(buf)
+    for entry in index:
+        buf += _INDEX_ENTRY.pack(*entry)
+    buf += _TRAILER.pack(index_offset, len(index), 0, b"OMTX")
+
+    path.write_bytes(bytes(buf))
+    return path
+
+
+BLOCK_A = [
+    (0, "kernel_a", 1_000, 2_000),
+    (1, "kernel_b", 1_500, 3_000),
+]
+BLOCK_B = [
+    (0, "kernel_a", 10_000, 11_000),
+]
+BLOCK_C = [
+    (2, "kernel_c", 20_000, 21_000),
+    (0, "kernel_a", 22_000, 25_000),
+]
+
+
+@pytest.fixture
+def trace_path(tmp_path):
+    return write_trace_file(tmp_path / "trace.omtf", [BLOCK_A, BLOCK_B, BLOCK_C])
+
+
+class TestFileValidation:
+    def test_rejects_wrong_magic(self, tmp_path):
+        """A file that doesn't start with the OMTF magic is rejected."""
+        path = tmp_path / "bogus.omtf"
+        path.write_bytes(b"NOPE" + b"\0" * 100)
+
+        with pytest.raises(ValueError, match="not an omnistat trace file"):
+            TraceFileReader(path)
+
+    def test_rejects_unknown_version(self, tmp_path):
+        """A version byte this reader doesn't understand is rejected."""
+        path = write_trace_file(tmp_path / "trace.omtf", [BLOCK_A])
+        data = bytearray(path.read_bytes())
+        data[4] = 99
+        path.write_bytes(bytes(data))
+
+        with pytest.raises(ValueError, match="unsupported trace file version"):
+            TraceFileReader(path)
+
+    def test_rejects_missing_trailer(self, tmp_path):
+        """A file truncated before the trailer (e.g. the writer was killed
+        mid-run) is reported as incomplete rather than misparsed."""
+        path = write_trace_file(tmp_path / "trace.omtf", [BLOCK_A])
+        data = path.read_bytes()
+        path.write_bytes(data[: -_TRAILER.size])
+
+        with pytest.raises(ValueError, match="missing trace file trailer"):
+            TraceFileReader(path)
+
+    def test_rejects_corrupt_block_header(self, trace_path):
+        """An index entry pointing at bytes without a block header fails the
+        per-block magic check instead of decoding garbage."""
+        data = bytearray(trace_path.read_bytes())
+        reader = TraceFileReader(trace_path)
+        offset = reader.index[1][0]
+        reader.close()
+        data[offset : offset + 4] = b"XXXX"
+        trace_path.write_bytes(bytes(data))
+
+        reader = TraceFileReader(trace_path)
+        with pytest.raises(ValueError, match="corrupt block header"):
+            list(reader.records())
+        reader.close()
+
+
+class TestBlockIteration:
+    def test_all_records_in_append_order(self, trace_path):
+        """Iterating without a slice yields every record, block by block."""
+        reader = TraceFileReader(trace_path)
+
+        assert list(reader.records()) == BLOCK_A + BLOCK_B + BLOCK_C
+        reader.close()
+
+    def test_record_count_from_index(self, trace_path):
+        """num_records sums the footer index without touching any block."""
+        reader = TraceFileReader(trace_path)
+
+        assert reader.num_records == 5
+        reader.close()
+
+    def test_time_range(self, trace_path):
+        """time_range spans the earliest start to the latest end in the index."""
+        reader = TraceFileReader(trace_path)
+
+        assert reader.time_range() == (1_000, 25_000)
+        reader.close()
+
+    def test_empty_file(self, tmp_path):
+        """A file closed without any blocks has an empty index."""
+        path = write_trace_file(tmp_path / "empty.omtf", [])
+        reader = TraceFileReader(path)
+
+        assert reader.num_records == 0
+        assert reader.time_range() is None
+        assert list(reader.records()) == []
+        reader.close()
+
+
+class TestIndexSlicing:
+    def test_slice_selects_overlapping_blocks(self, trace_path):
+        """A slice covering only the middle block returns its records."""
+        reader = TraceFileReader(trace_path)
+
+        assert list(reader.records(start_ns=9_000, end_ns=12_000)) == BLOCK_B
+        reader.close()
+
+    def test_slice_skips_blocks_via_index(self, trace_path):
+        """Blocks outside the slice are never decoded: corrupt their payloads
+        on disk and a sliced read must still succeed."""
+        data = bytearray(trace_path.read_bytes())
+        reader = TraceFileReader(trace_path)
+        for offset, payload_bytes, _, _, _ in (reader.index[0], reader.index[2]):
+            start = offset + _BLOCK_HEADER.size
+            data[start : start + payload_bytes] = b"\xff" * payload_bytes
+        reader.close()
+        trace_path.write_bytes(bytes(data))
+
+        reader = TraceFileReader(trace_path)
+        assert list(reader.records(start_ns=9_000, end_ns=12_000)) == BLOCK_B
+        reader.close()
+
+    def test_records_filtered_within_block(self, trace_path):
+        """Records of an overlapping block that fall outside the slice are
+        dropped individually."""
+        reader = TraceFileReader(trace_path)
+
+        # Only kernel_b of BLOCK_A overlaps [2_500, 3_500]
+        assert list(reader.records(start_ns=2_500, end_ns=3_500)) == [BLOCK_A[1]]
+        reader.close()
+
+    def test_open_ended_slices(self, trace_path):
+        """Omitting either bound leaves that side of the slice open."""
+        reader = TraceFileReader(trace_path)
+
+        assert list(reader.records(start_ns=10_500)) == BLOCK_B + BLOCK_C
+        assert list(reader.records(end_ns=3_000)) == BLOCK_A
+        reader.close()
+
+
+class TestByteLayout:
+    def test_golden_file(self, tmp_path):
+        """Pin the on-disk layout with a handcrafted byte literal, so the
+        fixture writer and the reader can't drift together: one block holding
+        one record, gpu 3, kernel "k", dispatched [256, 512) ns."""
+        header = b"OMTF" + b"\x01" + b"\x00" * 3 + b"\x00\x10\x00\x00"
+        payload = (
+            b"OMTR" + b"\x01" + b"\x00" * 3 + b"\x01\x00\x00\x00" + b"\x00" * 4
+            + b"\x03\x00\x00\x00" + b"\x01\x00\x00\x00"
+            + b"\x00\x01" + b"\x00" * 6 + b"\x00\x02" + b"\x00" * 6
+            + b"k"
+        )
+        block = (
+            b"OMTB" + bytes([len(payload)]) + b"\x00" * 3 + b"\x01\x00\x00\x00" + b"\x00" * 4
+            + b"\x00\x01" + b"\x00" * 6 + b"\x00\x02" + b"\x00" * 6
+        )
+        index = (
+            b"\x00\x10" + b"\x00" * 6 + bytes([len(payload)]) + b"\x00" * 3
+            + b"\x01\x00\x00\x00" + b"\x00\x01" + b"\x00" * 6 + b"\x00\x02" + b"\x00" * 6
+        )
+        trailer = b"\x00\x20" + b"\x00" * 6 + b"\x01" + b"\x00" * 7 + b"\x00" * 4 + b"OMTX"
+
+        data = header + b"\0" * (4096 - len(header))
+        data += block + payload
+        data += b"\0" * (8192 - len(data))
+        data += index + trailer
+
+        path = tmp_path / "golden.omtf"
+        path.write_bytes(data)
+
+        reader = TraceFileReader(path)
+        assert reader.index == [(4096, len(payload), 1, 256, 512)]
+        assert list(reader.records()) == [(3, "k", 256, 512)]
+        reader.close()